@@ -5,13 +5,33 @@
     This file will read in the SAT problems from external DIMACS-format files
     and process them with a variety of SAT solving techniques: DPLL, WalkSAT,
     and a genetic algorithm.
+    Compile with: gcc -std=c11 -O2 -pthread SATsolver.c (the vectorized clause kernel is picked at runtime on AVX2 CPUs)
 */
 
+#define _POSIX_C_SOURCE 200809L // getline, mmap, fstat, sockets, fmemopen
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__) // AVX2 kernel is compiled in regardless of -mavx2 and only used if the CPU has it
+#include <immintrin.h>
+#define X86_KERNEL
+#define HAS_AVX2() __builtin_cpu_supports("avx2")
+#else
+#define HAS_AVX2() 0
+#endif
 
 #define MAX_CLAUSE_LENGTH 5
 #define SEED 21
@@ -21,11 +41,37 @@
 #define S_CNF_FILE "A3_tests/10.40.160707067.cnf" // for debugging purposes
 #define U_CNF_FILE "A3_tests/10.44.1247388329.cnf" // for debugging purposes
 #define GET_INDEX(x) (abs(x)-1)
+#define LANES 8 // clauses evaluated together by evaluateClauses(); one AVX2 register of ints
+#define BITMAP_WORDS(n) (((n)+31)/32)
+#define TEST_BIT(bitmap, i) (((bitmap)[(i)/32] >> ((i)%32)) & 1)
+#define MAX_VARIABLES (INT_MAX/2 - 1) // keeps literal positions (up to 2*num_variables+1) within an int
+#define MAX_CLAUSES ((INT_MAX - LANES) / (2*MAX_CLAUSE_LENGTH)) // keeps arena offsets and clause slot positions within an int
+#define LIT_INDEX(x) (2*GET_INDEX(x) + ((x) < 0)) // position of a literal in the occurrence lists: 2v for +v, 2v+1 for -v
+#define CACHE_BUCKETS 65536 // hash buckets for the #SAT component cache
+#define CACHE_BUDGET_MB 256 // component cache is flushed once it grows past this
+#define PROBE_INTERVAL 64 // DPLL() reruns failed-literal probing every this many nodes
+#define DAEMON_TIMEOUT_MS 1000 // --daemon time limit per request, unless the request starts with "c timeout <ms>"
+#define DAEMON_MAX_TIMEOUT_MS 60000 // upper bound on "c timeout <ms>"
+#define DAEMON_IO_TIMEOUT_MS 2000 // --daemon time limit for receiving a whole request, and again for writing the response
+#define DAEMON_SCRATCH_MB 1024 // --daemon requests whose search needs more scratch levels than this get "s ERROR"
+#define DAEMON_SCRATCH_KEEP_MB 16 // scratch a daemon worker keeps between requests
+#define DAEMON_QUEUE 64 // accepted connections waiting for a free worker
+#define LATENCY_SAMPLES 65536 // most recent request latencies the daemon keeps for percentiles
+#define PROOF_BUFFER_SIZE (1 << 20) // bytes of DRAT proof collected before the writer thread takes them
+#define IMAGE_MAGIC "SATBIN3" // first bytes of a binary instance cache file
+#define IMAGE_EXTENSION ".satbin" // foo.cnf is cached next to it as foo.cnf.satbin
 
 typedef struct { // going to store our SAT problem
     int num_clauses; // size of above array
     int num_variables; // no need to create an array to store symbols because they range from 1:num_variables
-    int **clauses;
+    int **clauses; // points into arena
+    int *arena; // all clauses back to back, MAX_CLAUSE_LENGTH ints each
+    void *mapping; // non-NULL if the arrays live in an mmap'd binary cache rather than on the heap
+    size_t mapping_size;
+    int num_slots; // num_clauses rounded up to a multiple of LANES
+    int *slot_literals; // structure-of-arrays copy of clauses: literal j of clause i is at slot_literals[j*num_slots + i], 0 as padding
+    int *occurrence_offsets; // clauses containing literal x are occurrences[occurrence_offsets[LIT_INDEX(x)]] up to occurrence_offsets[LIT_INDEX(x)+1]
+    int *occurrences;
 } SAT_problem;
 
 void intAdeepCopy(int dest[], int src[], int size) { // writing own b/c memcpy slow
@@ -43,69 +89,511 @@ float randFloat() {
     return rand() / (RAND_MAX + 1.0);
 }
 
-SAT_problem readInFile(char *filename) {
-    FILE *input;
-    input = fopen(filename,"r");
-    if (input == NULL) {
-        printf("%s not found.\n", filename);
-        exit(1);
+unsigned int hashKey(int *key, int key_size) { // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (int i=0; i<key_size; i++) {
+        for (int b=0; b<4; b++) {
+            hash ^= (key[i] >> (8*b)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+unsigned long long hashWords(void *data, size_t size) { // FNV-1a style, but 8 bytes per step; each step is a bijection of the hash, so changing any one word always changes the result
+    unsigned char *bytes = data;
+    unsigned long long hash = 14695981039346656037ull ^ size;
+    size_t i = 0;
+    for (; i+8 <= size; i+=8) {
+        unsigned long long word;
+        memcpy(&word, bytes + i, 8); // no alignment needed
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    unsigned long long tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    return (hash ^ tail) * 1099511628211ull;
+}
+bool growArray(void **array, size_t size) { // realloc that leaves *array alone on failure, so callers can report it and keep the old array
+    void *grown = realloc(*array, size);
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    return true;
+}
+bool buildClauseSlots(SAT_problem *prob) { // transposing clauses so slot j of every clause is contiguous; false if out of memory
+    prob->num_slots = (prob->num_clauses + LANES - 1) / LANES * LANES;
+    if (!growArray((void **) &prob->slot_literals, sizeof(int) * MAX_CLAUSE_LENGTH * (size_t) prob->num_slots + 1)) {
+        printf("error in realloc for clause slots!\n");
+        return false;
+    }
+    for (int j=0; j<MAX_CLAUSE_LENGTH; j++) {
+        for (int i=0; i<prob->num_slots; i++) {
+            int literal = (i < prob->num_clauses) ? prob->clauses[i][j] : 0; // padding clauses past the end are empty
+            prob->slot_literals[j*prob->num_slots + i] = literal;
+        }
+    }
+    return true;
+}
+bool buildOccurrences(SAT_problem *prob) { // counting sort of clause indices by literal; false if out of memory
+    if (!growArray((void **) &prob->occurrence_offsets, sizeof(int) * (2 * (size_t) prob->num_variables + 1))) {
+        printf("error in realloc for occurrence offsets!\n");
+        return false;
+    }
+    for (int i=0; i<=2*prob->num_variables; i++) {
+        prob->occurrence_offsets[i] = 0;
+    }
+    for (int i=0; i<prob->num_clauses; i++) {
+        for (int j=0; j<MAX_CLAUSE_LENGTH && prob->clauses[i][j] != 0; j++) {
+            prob->occurrence_offsets[LIT_INDEX(prob->clauses[i][j]) + 1]++;
+        }
+    }
+    for (int i=0; i<2*prob->num_variables; i++) { // turning counts into starting positions
+        prob->occurrence_offsets[i+1] += prob->occurrence_offsets[i];
+    }
+    int *next = malloc(sizeof(int) * 2 * (size_t) prob->num_variables);
+    if (next == NULL || !growArray((void **) &prob->occurrences, sizeof(int) * ((size_t) prob->occurrence_offsets[2*prob->num_variables] + 1))) {
+        printf("error in malloc for occurrences!\n");
+        free(next);
+        return false;
     }
+    intAdeepCopy(next, prob->occurrence_offsets, 2*prob->num_variables);
+    for (int i=0; i<prob->num_clauses; i++) {
+        for (int j=0; j<MAX_CLAUSE_LENGTH && prob->clauses[i][j] != 0; j++) {
+            prob->occurrences[next[LIT_INDEX(prob->clauses[i][j])]++] = i;
+        }
+    }
+    free(next);
+    return true;
+}
+void recordMasks(int i, unsigned int sat_mask, unsigned int unsat_mask, unsigned int *sat_bitmap, unsigned int *unsat_bitmap) { // stores the masks of group i into the bitmaps, either may be NULL
+    if (sat_bitmap != NULL) {
+        if (i % 32 == 0) {
+            sat_bitmap[i/32] = 0;
+        }
+        sat_bitmap[i/32] |= sat_mask << (i % 32);
+    }
+    if (unsat_bitmap != NULL) {
+        if (i % 32 == 0) {
+            unsat_bitmap[i/32] = 0;
+        }
+        unsat_bitmap[i/32] |= unsat_mask << (i % 32);
+    }
+}
+unsigned int paddingMask(SAT_problem prob, int i) { // lanes of group i that hold real clauses
+    return (prob.num_clauses - i < LANES) ? (1u << (prob.num_clauses - i)) - 1 : (1u << LANES) - 1;
+}
+#ifdef X86_KERNEL
+__attribute__((target("avx2"))) int evaluateClausesAVX2(SAT_problem prob, int *model, unsigned int *sat_bitmap, unsigned int *unsat_bitmap) {
+    int counter = 0;
+    __m256i zero = _mm256_setzero_si256();
+    __m256i one = _mm256_set1_epi32(1);
+    for (int i=0; i<prob.num_slots; i+=LANES) { // one group of LANES clauses at a time
+        __m256i satisfied = zero;
+        __m256i falsified = _mm256_set1_epi32(-1);
+        for (int j=0; j<MAX_CLAUSE_LENGTH; j++) {
+            __m256i literals = _mm256_loadu_si256((__m256i *) &prob.slot_literals[j*prob.num_slots + i]);
+            __m256i indices = _mm256_max_epi32(_mm256_sub_epi32(_mm256_abs_epi32(literals), one), zero); // GET_INDEX, with padding reading model[0] (the sign below zeroes it)
+            __m256i identifier = _mm256_sign_epi32(_mm256_i32gather_epi32(model, indices, 4), literals); // pos if true, neg if false, 0 if unassigned or padding
+            satisfied = _mm256_or_si256(satisfied, _mm256_cmpgt_epi32(identifier, zero));
+            falsified = _mm256_and_si256(falsified, _mm256_or_si256(_mm256_cmpgt_epi32(zero, identifier), _mm256_cmpeq_epi32(literals, zero)));
+        }
+        unsigned int sat_mask = _mm256_movemask_ps(_mm256_castsi256_ps(satisfied)) & paddingMask(prob, i); // bit k set if clause i+k has a true literal
+        unsigned int unsat_mask = _mm256_movemask_ps(_mm256_castsi256_ps(falsified)) & paddingMask(prob, i); // bit k set if every literal of clause i+k is false
+        recordMasks(i, sat_mask, unsat_mask, sat_bitmap, unsat_bitmap);
+        counter += __builtin_popcount(sat_mask);
+    }
+    return counter;
+}
+#endif
+int clauseStatus(int *clause, int *model) { // SAT, UNSAT or UNDET under model, stopping at the first true literal
+    bool falsified = true;
+    for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0; j++) {
+        int value = model[GET_INDEX(clause[j])];
+        if (value == clause[j]) {
+            return SAT;
+        }
+        falsified = falsified && value != 0;
+    }
+    return falsified ? UNSAT : UNDET;
+}
+int evaluateClauses(SAT_problem prob, int *model, unsigned int *sat_bitmap, unsigned int *unsat_bitmap) { // returns number of SAT clauses; bitmaps (either may be NULL) get one bit per clause
+#ifdef X86_KERNEL
+    if (HAS_AVX2()) {
+        return evaluateClausesAVX2(prob, model, sat_bitmap, unsat_bitmap);
+    }
+#endif
+    int counter = 0;
+    for (int i=0; i<prob.num_slots; i+=LANES) {
+        unsigned int sat_mask = 0;
+        unsigned int unsat_mask = 0;
+        for (int k=0; k<LANES && i+k < prob.num_clauses; k++) {
+            int status = clauseStatus(prob.clauses[i+k], model);
+            sat_mask |= (status == SAT) << k;
+            unsat_mask |= (status == UNSAT) << k;
+        }
+        recordMasks(i, sat_mask, unsat_mask, sat_bitmap, unsat_bitmap);
+        counter += __builtin_popcount(sat_mask);
+    }
+    return counter;
+}
 
-    SAT_problem prob;
+bool parseDIMACS(FILE *input, SAT_problem *prob, size_t input_size) { // fills prob, growing the arrays it already has (NULL for none) so callers can reuse them; false if input is not valid DIMACS or does not fit in memory
+    // input_size is the length of untrusted input (0 to trust the header): its header counts must be ones those bytes could describe
     char *line = NULL;
     char *token = NULL;
+    char *save = NULL; // strtok_r() position, since daemon workers parse concurrently
     size_t line_buffer_size = 0;
+    bool valid = true;
 
     do { // skipping all initial comments; after loop finishes, we should be on line containing p cnf X Y
-        getline(&line, &line_buffer_size, input);
-        token = strtok(line, " ");
-    } while (strcmp(token, "p") != 0);
+        if (getline(&line, &line_buffer_size, input) == -1) {
+            free(line);
+            return false;
+        }
+        token = strtok_r(line, " \t\r\n", &save);
+    } while (token == NULL || strcmp(token, "p") != 0);
 
-    token = strtok(NULL, " "); // skipping "cnf"
-    token = strtok(NULL, " "); // this token contains the number of symbols
-    prob.num_variables = atoi(token);
+    token = strtok_r(NULL, " \t\r\n", &save); // skipping "cnf"
+    token = (token != NULL) ? strtok_r(NULL, " \t\r\n", &save) : NULL; // this token contains the number of symbols
+    long num_variables = (token != NULL) ? strtol(token, NULL, 10) : 0;
 
-    token = strtok(NULL, " "); // this token contains the number of clauses
-    prob.num_clauses = atoi(token);
+    token = (token != NULL) ? strtok_r(NULL, " \t\r\n", &save) : NULL; // this token contains the number of clauses
+    long num_clauses = (token != NULL) ? strtol(token, NULL, 10) : -1;
+    if (num_variables <= 0 || num_variables > MAX_VARIABLES || num_clauses < 0 || num_clauses > MAX_CLAUSES
+        || (input_size > 0 && ((size_t) num_variables > input_size || (size_t) num_clauses > input_size / 2 + 1))) { // every clause takes at least "0\n"; a variable per byte is already generous
+        free(line);
+        return false;
+    }
+    prob->num_variables = num_variables;
+    prob->num_clauses = num_clauses;
 
-    prob.clauses = malloc(sizeof(int *)*prob.num_clauses);
-    if (prob.clauses == NULL) {
-        printf("error in malloc for clauses!\n");
-        exit(1);
+    if (!growArray((void **) &prob->clauses, sizeof(int *) * (size_t) prob->num_clauses + 1)
+        || !growArray((void **) &prob->arena, sizeof(int) * MAX_CLAUSE_LENGTH * (size_t) prob->num_clauses + 1)) { // arbitrarily assuming max length of a clause; one block so it can be cached as is
+        printf("error in realloc for clauses!\n");
+        free(line);
+        return false;
     }
-    for (int i=0; i<prob.num_clauses; i++) {
-        prob.clauses[i] = malloc(sizeof(int)*MAX_CLAUSE_LENGTH); // arbitrarily assuming max length of a clause
-        if (prob.clauses[i] == NULL) {
-            printf("error in malloc for individual disjunct clauses!\n");
-            exit(1);
-        }
+    for (int i=0; i<prob->num_clauses; i++) {
+        prob->clauses[i] = &prob->arena[i*MAX_CLAUSE_LENGTH];
     }
+    prob->mapping = NULL;
+    prob->mapping_size = 0;
     int j = 0;
-    for (int i=0; i<prob.num_clauses; i++) { // getting all clauses
-        getline(&line, &line_buffer_size, input);
-        token = strtok(line, " ");
-        if (strcmp(token, "c")==0) { // skipping comments
-            getline(&line, &line_buffer_size, input);
-            token = strtok(NULL, " ");
+    for (int i=0; i<prob->num_clauses && valid; i++) { // getting all clauses, one per line
+        token = NULL;
+        while (token == NULL || strcmp(token, "c") == 0) { // skipping comments and blank lines
+            if (getline(&line, &line_buffer_size, input) == -1) {
+                break;
+            }
+            token = strtok_r(line, " \t\r\n", &save);
         }
         j=0;
-        while(strcmp(token, "0\n")!=0) {
-            prob.clauses[i][j] = atoi(token);
-            token = strtok(NULL, " ");
-            j++;
+        while (token != NULL && strcmp(token, "0") != 0 && valid) {
+            long literal = strtol(token, NULL, 10);
+            if (j == MAX_CLAUSE_LENGTH || literal == 0 || literal > prob->num_variables || literal < -prob->num_variables) {
+                valid = false;
+            } else {
+                prob->clauses[i][j] = literal;
+                j++;
+            }
+            token = strtok_r(NULL, " \t\r\n", &save);
+        }
+        if (token == NULL) { // ran out of input, or clause missing its terminating 0
+            valid = false;
         }
         while (j<MAX_CLAUSE_LENGTH) {
-            prob.clauses[i][j] = 0; // filling remaining parts of clause
+            prob->clauses[i][j] = 0; // filling remaining parts of clause
             j++;
         }
     }
+    free(line);
+    return valid && buildClauseSlots(prob) && buildOccurrences(prob);
+}
+SAT_problem readInFile(char *filename) {
+    FILE *input;
+    input = fopen(filename,"r");
+    if (input == NULL) {
+        printf("%s not found.\n", filename);
+        exit(1);
+    }
+
+    SAT_problem prob = {0}; // no arrays yet for parseDIMACS to reuse
+    if (!parseDIMACS(input, &prob, 0)) {
+        printf("%s is not a valid DIMACS CNF file.\n", filename);
+        exit(1);
+    }
     fclose(input);
     return prob;
 }
+typedef struct { // start of a binary instance image; the payload follows it directly
+    char magic[8]; // IMAGE_MAGIC
+    int max_clause_length; // images written by a build with a different MAX_CLAUSE_LENGTH are rejected
+    int num_variables;
+    int num_clauses;
+    int num_slots;
+    int num_occurrences;
+    unsigned long long checksum; // hashWords() of the payload
+    long long source_size; // size and hashWords() of the DIMACS file the image was built from, 0 if none
+    unsigned long long source_hash;
+} image_header;
+
+unsigned long long imagePayloadInts(int num_variables, int num_clauses, int num_slots, int num_occurrences) { // arena, clause slots, occurrence lists; 64-bit so hostile header counts cannot wrap it
+    return (unsigned long long) num_clauses*MAX_CLAUSE_LENGTH + (unsigned long long) MAX_CLAUSE_LENGTH*num_slots + 2ull*num_variables + 1 + num_occurrences;
+}
+void *buildProblemImage(SAT_problem prob, long long source_size, unsigned long long source_hash, size_t *size) { // serializes prob, caller frees; NULL if it is too big for an image
+    int num_occurrences = prob.occurrence_offsets[2*prob.num_variables];
+    unsigned long long payload_ints = imagePayloadInts(prob.num_variables, prob.num_clauses, prob.num_slots, num_occurrences);
+    if (payload_ints > INT_MAX) { // the offsets below are ints
+        return NULL;
+    }
+    *size = sizeof(image_header) + sizeof(int) * payload_ints;
+    image_header *header = calloc(1, *size);
+    if (header == NULL) {
+        printf("error in calloc for problem image!\n");
+        exit(1);
+    }
+    int *payload = (int *) (header + 1);
+    int position = 0;
+    intAdeepCopy(payload + position, prob.arena, prob.num_clauses*MAX_CLAUSE_LENGTH);
+    position += prob.num_clauses*MAX_CLAUSE_LENGTH;
+    intAdeepCopy(payload + position, prob.slot_literals, MAX_CLAUSE_LENGTH*prob.num_slots);
+    position += MAX_CLAUSE_LENGTH*prob.num_slots;
+    intAdeepCopy(payload + position, prob.occurrence_offsets, 2*prob.num_variables + 1);
+    position += 2*prob.num_variables + 1;
+    intAdeepCopy(payload + position, prob.occurrences, num_occurrences);
+    memcpy(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header->max_clause_length = MAX_CLAUSE_LENGTH;
+    header->num_variables = prob.num_variables;
+    header->num_clauses = prob.num_clauses;
+    header->num_slots = prob.num_slots;
+    header->num_occurrences = num_occurrences;
+    header->checksum = hashWords(payload, sizeof(int) * payload_ints);
+    header->source_size = source_size;
+    header->source_hash = source_hash;
+    return header;
+}
+bool validImagePayload(image_header *header, int *payload) { // checks everything DPLL() and propagate() index with; the checksum alone is no defense, since anyone can compute it
+    int num_variables = header->num_variables;
+    int num_clauses = header->num_clauses;
+    int num_slots = header->num_slots;
+    int *arena = payload;
+    int *slot_literals = arena + num_clauses*MAX_CLAUSE_LENGTH;
+    int *occurrence_offsets = slot_literals + MAX_CLAUSE_LENGTH*num_slots;
+    int *occurrences = occurrence_offsets + 2*num_variables + 1;
+    for (int i=0; i<num_clauses; i++) { // literals in range, zero padding only at the end
+        bool ended = false;
+        for (int j=0; j<MAX_CLAUSE_LENGTH; j++) {
+            int literal = arena[i*MAX_CLAUSE_LENGTH + j];
+            if (literal < -num_variables || literal > num_variables || (ended && literal != 0)) {
+                return false;
+            }
+            ended = ended || literal == 0;
+        }
+    }
+    for (int j=0; j<MAX_CLAUSE_LENGTH; j++) { // clause slots must be exactly what buildClauseSlots() would make
+        for (int i=0; i<num_slots; i++) {
+            int literal = (i < num_clauses) ? arena[i*MAX_CLAUSE_LENGTH + j] : 0;
+            if (slot_literals[j*num_slots + i] != literal) {
+                return false;
+            }
+        }
+    }
+    if (occurrence_offsets[0] != 0 || occurrence_offsets[2*num_variables] != header->num_occurrences) {
+        return false;
+    }
+    for (int x=0; x<2*num_variables; x++) { // offsets ascending, and every listed clause really contains the literal
+        if (occurrence_offsets[x+1] < occurrence_offsets[x]) {
+            return false;
+        }
+        for (int k=occurrence_offsets[x]; k<occurrence_offsets[x+1]; k++) {
+            if (occurrences[k] < 0 || occurrences[k] >= num_clauses) {
+                return false;
+            }
+            bool contains = false;
+            for (int j=0; j<MAX_CLAUSE_LENGTH; j++) {
+                int literal = arena[occurrences[k]*MAX_CLAUSE_LENGTH + j];
+                contains = contains || (literal != 0 && LIT_INDEX(literal) == x);
+            }
+            if (!contains) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+bool problemFromImage(void *image, size_t size, bool trusted, SAT_problem *prob) { // points prob's arrays into image (no copying); false if image is not a valid instance. Only untrusted images get the full validImagePayload() pass, our own cache files just need their checksum
+    image_header *header = image;
+    if (size < sizeof(image_header) || memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || header->max_clause_length != MAX_CLAUSE_LENGTH) {
+        return false;
+    }
+    if (header->num_variables <= 0 || header->num_variables > MAX_VARIABLES || header->num_clauses < 0 || header->num_clauses > MAX_CLAUSES
+        || header->num_slots != (header->num_clauses + LANES - 1) / LANES * LANES
+        || header->num_occurrences < 0 || header->num_occurrences > header->num_clauses*MAX_CLAUSE_LENGTH) {
+        return false;
+    }
+    unsigned long long payload_ints = imagePayloadInts(header->num_variables, header->num_clauses, header->num_slots, header->num_occurrences);
+    int *payload = (int *) (header + 1);
+    if (payload_ints > INT_MAX || payload_ints != (size - sizeof(image_header)) / sizeof(int) || (size - sizeof(image_header)) % sizeof(int) != 0
+        || hashWords(payload, sizeof(int) * payload_ints) != header->checksum || (!trusted && !validImagePayload(header, payload))) {
+        return false;
+    }
+    prob->num_variables = header->num_variables;
+    prob->num_clauses = header->num_clauses;
+    prob->num_slots = header->num_slots;
+    prob->arena = payload;
+    prob->slot_literals = prob->arena + prob->num_clauses*MAX_CLAUSE_LENGTH;
+    prob->occurrence_offsets = prob->slot_literals + MAX_CLAUSE_LENGTH*prob->num_slots;
+    prob->occurrences = prob->occurrence_offsets + 2*prob->num_variables + 1;
+    prob->clauses = malloc(sizeof(int *) * (size_t) prob->num_clauses + 1); // the only part that is not shared
+    if (prob->clauses == NULL) {
+        printf("error in malloc for clauses!\n");
+        return false;
+    }
+    for (int i=0; i<prob->num_clauses; i++) {
+        prob->clauses[i] = &prob->arena[i*MAX_CLAUSE_LENGTH];
+    }
+    prob->mapping = NULL;
+    prob->mapping_size = 0;
+    return true;
+}
+bool loadProblemCache(char *cache_filename, long long source_size, unsigned long long source_hash, SAT_problem *prob) { // maps a cache file read-only; false if missing, corrupt, or stale
+    int fd = open(cache_filename, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat cache;
+    if (fstat(fd, &cache) == -1 || cache.st_size < (off_t) sizeof(image_header)) {
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, cache.st_size, PROT_READ, MAP_SHARED, fd, 0); // shared so every solver process reads the same page cache pages
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    image_header *header = mapping;
+    if (header->source_size != source_size || header->source_hash != source_hash
+        || !problemFromImage(mapping, cache.st_size, true, prob)) { // DIMACS file changed since the cache was written, or cache damaged
+        munmap(mapping, cache.st_size);
+        return false;
+    }
+    prob->mapping = mapping;
+    prob->mapping_size = cache.st_size;
+    return true;
+}
+void writeProblemCache(char *cache_filename, SAT_problem prob, long long source_size, unsigned long long source_hash) {
+    size_t size;
+    void *image = buildProblemImage(prob, source_size, source_hash, &size);
+    if (image == NULL) {
+        printf("%s would be too big to cache.\n", cache_filename);
+        return;
+    }
+    char *temp_filename = malloc(strlen(cache_filename) + 32);
+    if (temp_filename == NULL) {
+        printf("error in malloc for cache filename!\n");
+        exit(1);
+    }
+    sprintf(temp_filename, "%s.%ld", cache_filename, (long) getpid());
+    FILE *output = fopen(temp_filename, "wb");
+    if (output == NULL) { // read-only directory etc.; we just solve uncached
+        printf("could not write cache %s.\n", cache_filename);
+    } else {
+        bool written = fwrite(image, 1, size, output) == size;
+        if (fclose(output) == 0 && written) {
+            rename(temp_filename, cache_filename); // atomic, so other processes never map a half-written file
+        } else {
+            remove(temp_filename);
+        }
+    }
+    free(temp_filename);
+    free(image);
+}
+SAT_problem readInFileCached(char *filename) { // like readInFile, but through filename.satbin when it was built from the same bytes
+    SAT_problem prob = {0};
+    struct stat source;
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, &source) == -1) {
+        printf("%s not found.\n", filename);
+        exit(1);
+    }
+    void *text = (source.st_size > 0) ? mmap(NULL, source.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (text == MAP_FAILED) { // empty or unmappable, readInFile reports it
+        return readInFile(filename);
+    }
+    unsigned long long source_hash = hashWords(text, source.st_size); // much cheaper than tokenizing, and unlike size and mtime it catches every edit
+    char *cache_filename = malloc(strlen(filename) + sizeof(IMAGE_EXTENSION));
+    if (cache_filename == NULL) {
+        printf("error in malloc for cache filename!\n");
+        exit(1);
+    }
+    sprintf(cache_filename, "%s%s", filename, IMAGE_EXTENSION);
+    if (!loadProblemCache(cache_filename, source.st_size, source_hash, &prob)) {
+        FILE *input = fmemopen(text, source.st_size, "r"); // parsing the very bytes we hashed, so the cache cannot pair them with a newer file
+        if (input == NULL || !parseDIMACS(input, &prob, 0)) {
+            printf("%s is not a valid DIMACS CNF file.\n", filename);
+            exit(1);
+        }
+        fclose(input);
+        writeProblemCache(cache_filename, prob, source.st_size, source_hash);
+    }
+    munmap(text, source.st_size);
+    free(cache_filename);
+    return prob;
+}
+void freeProblem(SAT_problem prob) {
+    free(prob.clauses);
+    if (prob.mapping != NULL) {
+        munmap(prob.mapping, prob.mapping_size);
+    } else {
+        free(prob.arena);
+        free(prob.slot_literals);
+        free(prob.occurrence_offsets);
+        free(prob.occurrences);
+    }
+}
+
+bool propagate(SAT_problem prob, int *model, int *trail, int *trail_size, int head) { // unit propagation of trail[head:]; returns false on a conflict
+    while (head < *trail_size) {
+        int false_literal = -trail[head];
+        head++;
+        for (int k=prob.occurrence_offsets[LIT_INDEX(false_literal)]; k<prob.occurrence_offsets[LIT_INDEX(false_literal)+1]; k++) { // only clauses that just lost a literal can become unit
+            int *clause = prob.clauses[prob.occurrences[k]];
+            bool clause_SAT = false;
+            int num_unassigned = 0;
+            int unassigned_variable = 0;
+            for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0 && !clause_SAT; j++) {
+                if (model[GET_INDEX(clause[j])] == clause[j]) {
+                    clause_SAT = true;
+                } else if (model[GET_INDEX(clause[j])] == 0) {
+                    num_unassigned++;
+                    unassigned_variable = clause[j];
+                }
+            }
+            if (clause_SAT) {
+                continue;
+            }
+            if (num_unassigned == 0) {
+                return false;
+            }
+            if (num_unassigned == 1) {
+                model[GET_INDEX(unassigned_variable)] = unassigned_variable;
+                trail[*trail_size] = unassigned_variable;
+                (*trail_size)++;
+            }
+        }
+    }
+    return true;
+}
+void undoTrail(int *model, int *trail, int *trail_size, int target) { // unassigning everything pushed after position target
+    while (*trail_size > target) {
+        (*trail_size)--;
+        model[GET_INDEX(trail[*trail_size])] = 0;
+    }
+}
 
-int findPureSymbol(SAT_problem prob, int *marked_clauses, int *symbols, int *model) { // going to iterate through UNSAT clauses (assuming pure variables) and mark any differences
+int findPureSymbol(SAT_problem prob, int *marked_clauses, int *symbols, int *model, int *check) { // going to iterate through UNSAT clauses (assuming pure variables) and mark any differences; check is num_variables ints of scratch
     int result;
-    int *check = malloc(sizeof(int) * prob.num_variables); // creating an array to hold the first instance found
     for (int i=0; i<prob.num_variables; i++) { // initializing all to 0
         check[i] = 0;
     }
@@ -121,11 +609,9 @@ int findPureSymbol(SAT_problem prob, int *marked_clauses, int *symbols, int *mod
     for (int i=0; i<prob.num_variables; i++) {
         if ((check[i] != 0) && (check[i] != prob.num_variables+1) && (symbols[GET_INDEX(check[i])] != 0)) {
             result = check[i];
-            free(check);
             return result; 
         }
     }
-    free(check);
     return 0; // return 0 if no pure symbol found
 }
 int findUnitClause(SAT_problem prob, int *marked_clauses, int *symbols, int *model) { // going to iterate through UNSAT clauses and see which ones are reducible based on current assignments
@@ -146,12 +632,356 @@ int findUnitClause(SAT_problem prob, int *marked_clauses, int *symbols, int *mod
     }
     return 0; // if no unit clause found, return 0
 }
-bool DPLL(SAT_problem prob, int *marked_clauses, int *symbols, int *model, int *count) { // recursive call
-    (*count)++;
+typedef struct { // binary DRAT output, double buffered so a background thread does the writing
+    FILE *output;
+    unsigned char *buffers[2];
+    size_t capacity; // size of each buffer
+    int active; // buffer the solver is filling
+    size_t used; // bytes in the active buffer
+    size_t pending; // bytes in the other buffer the writer has yet to write, 0 once it is idle
+    bool closing;
+    bool failed; // a write went wrong, so the file is not the whole proof
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+} proof_writer;
+
+void *proofWriterThread(void *arg) {
+    proof_writer *proof = arg;
+    pthread_mutex_lock(&proof->lock);
+    while (true) {
+        while (proof->pending == 0 && !proof->closing) {
+            pthread_cond_wait(&proof->work, &proof->lock);
+        }
+        if (proof->pending == 0) { // closing and nothing left
+            break;
+        }
+        unsigned char *buffer = proof->buffers[1 - proof->active];
+        size_t size = proof->pending;
+        bool failed = proof->failed;
+        pthread_mutex_unlock(&proof->lock); // the solver keeps filling the other buffer meanwhile
+        failed = failed || fwrite(buffer, 1, size, proof->output) != size; // after a failure there is no point writing the rest
+        pthread_mutex_lock(&proof->lock);
+        proof->failed = failed;
+        proof->pending = 0;
+        pthread_cond_signal(&proof->done);
+    }
+    pthread_mutex_unlock(&proof->lock);
+    return NULL;
+}
+proof_writer *openProof(char *filename, int num_variables) { // NULL if the file cannot be created
+    FILE *output = fopen(filename, "wb");
+    if (output == NULL) {
+        return NULL;
+    }
+    proof_writer *proof = malloc(sizeof(proof_writer));
+    if (proof == NULL) {
+        printf("error in malloc for proof writer!\n");
+        exit(1);
+    }
+    proof->output = output;
+    proof->capacity = PROOF_BUFFER_SIZE + 5 * ((size_t) num_variables + 8); // always room for at least one whole lemma
+    proof->buffers[0] = malloc(proof->capacity);
+    proof->buffers[1] = malloc(proof->capacity);
+    if (proof->buffers[0] == NULL || proof->buffers[1] == NULL) {
+        printf("error in malloc for proof buffers!\n");
+        exit(1);
+    }
+    proof->active = 0;
+    proof->used = 0;
+    proof->pending = 0;
+    proof->closing = false;
+    proof->failed = false;
+    pthread_mutex_init(&proof->lock, NULL);
+    pthread_cond_init(&proof->work, NULL);
+    pthread_cond_init(&proof->done, NULL);
+    pthread_create(&proof->thread, NULL, proofWriterThread, proof);
+    return proof;
+}
+void swapProofBuffers(proof_writer *proof) { // hands the active buffer to the writer, waiting only if it is still busy with the previous one
+    pthread_mutex_lock(&proof->lock);
+    while (proof->pending != 0) {
+        pthread_cond_wait(&proof->done, &proof->lock);
+    }
+    proof->pending = proof->used;
+    proof->active = 1 - proof->active;
+    proof->used = 0;
+    pthread_cond_signal(&proof->work);
+    pthread_mutex_unlock(&proof->lock);
+}
+bool closeProof(proof_writer *proof) { // false if any part of the proof failed to reach the file
+    if (proof->used > 0) {
+        swapProofBuffers(proof);
+    }
+    pthread_mutex_lock(&proof->lock);
+    proof->closing = true;
+    pthread_cond_signal(&proof->work);
+    pthread_mutex_unlock(&proof->lock);
+    pthread_join(proof->thread, NULL);
+    bool written = fclose(proof->output) == 0 && !proof->failed; // fclose flushes stdio's own buffer, which can fail too
+    free(proof->buffers[0]);
+    free(proof->buffers[1]);
+    pthread_mutex_destroy(&proof->lock);
+    pthread_cond_destroy(&proof->work);
+    pthread_cond_destroy(&proof->done);
+    free(proof);
+    return written;
+}
+void proofLiteral(proof_writer *proof, int literal) { // binary DRAT: 2v (+1 if negative) as a little-endian base-128 varint
+    unsigned int encoded = 2*abs(literal) + (literal < 0);
+    unsigned char *buffer = proof->buffers[proof->active];
+    while (encoded > 127) {
+        buffer[proof->used] = (encoded & 127) | 128;
+        proof->used++;
+        encoded >>= 7;
+    }
+    buffer[proof->used] = encoded;
+    proof->used++;
+}
+void proofLemma(proof_writer *proof, char kind, int *literals, int num_literals, int *model, int num_variables) { // adds ('a') or deletes ('d') the clause literals OR not(model); no-op without a proof
+    if (proof == NULL) {
+        return;
+    }
+    if (proof->used + 5 * ((size_t) num_literals + num_variables + 2) > proof->capacity) {
+        swapProofBuffers(proof);
+    }
+    proof->buffers[proof->active][proof->used] = kind;
+    proof->used++;
+    for (int i=0; i<num_literals; i++) { // first literal is the RAT pivot, so these come before the model
+        proofLiteral(proof, literals[i]);
+    }
+    for (int i=0; i<num_variables; i++) {
+        if (model != NULL && model[i] != 0) {
+            proofLiteral(proof, -model[i]);
+        }
+    }
+    proof->buffers[proof->active][proof->used] = 0;
+    proof->used++;
+}
+typedef struct { // arrays the search reuses instead of allocating at every node; daemon workers keep theirs across requests
+    size_t level_size; // ints in each level
+    int num_levels;
+    int **levels; // levels[d] holds what the search needs at depth d: symbols, model, model1, model2, units (num_variables each), then marked clauses
+    size_t work_size;
+    int *work; // per-node temporaries of probeLiterals() and findPureSymbol(), never needed across a recursive call
+} search_scratch;
+
+void freeScratch(search_scratch *scratch) {
+    for (int d=0; d<scratch->num_levels; d++) {
+        free(scratch->levels[d]);
+    }
+    free(scratch->levels);
+    free(scratch->work);
+    memset(scratch, 0, sizeof(search_scratch));
+}
+void trimScratch(search_scratch *scratch, size_t keep_bytes) { // frees the deepest levels (and work, if it alone is over) until what is left fits in keep_bytes
+    size_t keep_levels = (scratch->level_size > 0) ? keep_bytes / (sizeof(int) * scratch->level_size) : 0;
+    for (size_t d=keep_levels; d<(size_t) scratch->num_levels; d++) {
+        free(scratch->levels[d]);
+        scratch->levels[d] = NULL;
+    }
+    if (sizeof(int) * scratch->work_size > keep_bytes) {
+        free(scratch->work);
+        scratch->work = NULL;
+        scratch->work_size = 0;
+    }
+}
+typedef struct { // bookkeeping shared by every DPLL() call of one search
+    int count; // nodes expanded
+    int *solution; // filled in with the model once one is found
+    bool has_deadline;
+    struct timespec deadline; // CLOCK_MONOTONIC time at which the search gives up
+    bool timed_out; // search abandoned: out of time, or out_of_memory
+    bool out_of_memory;
+    proof_writer *proof; // DRAT lemmas go here, NULL for none
+    search_scratch *scratch;
+    size_t scratch_limit; // bytes of scratch levels the search may use, 0 for no limit
+} search_state;
+bool pastDeadline(search_state *state) {
+    if (state->has_deadline && !state->timed_out) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        state->timed_out = now.tv_sec > state->deadline.tv_sec || (now.tv_sec == state->deadline.tv_sec && now.tv_nsec >= state->deadline.tv_nsec);
+    }
+    return state->timed_out;
+}
+int *scratchLevel(SAT_problem prob, int depth, search_state *state) { // arrays for depth, NULL (and the search abandoned) if out of memory
+    search_scratch *scratch = state->scratch;
+    size_t needed = 5 * (size_t) prob.num_variables + prob.num_clauses + 1;
+    if (needed > scratch->level_size) { // bigger problem than any before: dropping the smaller levels; only happens at the root
+        for (int d=0; d<scratch->num_levels; d++) {
+            free(scratch->levels[d]);
+            scratch->levels[d] = NULL;
+        }
+        scratch->level_size = needed;
+    }
+    if (state->scratch_limit > 0 && sizeof(int) * scratch->level_size > state->scratch_limit / ((size_t) depth + 1)) { // levels 0..depth would not fit
+        state->out_of_memory = state->timed_out = true;
+        return NULL;
+    }
+    if (depth >= scratch->num_levels) {
+        int num_levels = depth + 64;
+        if (!growArray((void **) &scratch->levels, sizeof(int *) * num_levels)) {
+            state->out_of_memory = state->timed_out = true;
+            return NULL;
+        }
+        for (int d=scratch->num_levels; d<num_levels; d++) {
+            scratch->levels[d] = NULL;
+        }
+        scratch->num_levels = num_levels;
+    }
+    if (scratch->levels[depth] == NULL) {
+        scratch->levels[depth] = malloc(sizeof(int) * scratch->level_size);
+        if (scratch->levels[depth] == NULL) {
+            state->out_of_memory = state->timed_out = true;
+        }
+    }
+    return scratch->levels[depth];
+}
+int *scratchWork(SAT_problem prob, search_state *state) { // 5*num_variables+3 ints of temporaries, NULL (and the search abandoned) if out of memory
+    search_scratch *scratch = state->scratch;
+    size_t needed = 5 * (size_t) prob.num_variables + 3;
+    if (needed > scratch->work_size) {
+        if (!growArray((void **) &scratch->work, sizeof(int) * needed)) {
+            state->out_of_memory = state->timed_out = true;
+            return NULL;
+        }
+        scratch->work_size = needed;
+    }
+    return scratch->work;
+}
+int probeLiterals(SAT_problem prob, int *model, int *units, search_state *state) { // failed-literal probing; writes literals forced under model into units in the order found, returns how many, or -1 if model cannot be extended
+    proof_writer *proof = state->proof;
+    int *work = scratchWork(prob, state);
+    if (work == NULL) { // nothing probed; the search is being abandoned anyway
+        return 0;
+    }
+    int *trail = work + prob.num_variables;
+    int *positive_trail = trail + prob.num_variables + 1; // what the positive probe implied
+    int *common = positive_trail + prob.num_variables + 1; // implied by both probes
+    int *implied = common + prob.num_variables + 1; // implied[v] is the literal of v the positive probe implied, 0 if none
+    for (int i=0; i<prob.num_variables; i++) {
+        implied[i] = 0;
+    }
+    intAdeepCopy(work, model, prob.num_variables);
+    int trail_size = 0;
+    int num_units = 0;
+    int failed = 0; // literal whose both polarities failed
+    bool refuted = false;
+    bool changed = true;
+    while (changed && !refuted) { // a new unit can make earlier probes fail, so going around until nothing changes
+        changed = false;
+        for (int i=0; i<prob.num_variables && !refuted; i++) {
+            if (work[i] != 0) {
+                continue;
+            }
+            if (pastDeadline(state)) { // a probe can propagate through the whole instance, so one pass over a big one can outlast the deadline on its own
+                return num_units; // still implied by model, and the caller sees timed_out
+            }
+            work[i] = i+1; // probing v
+            trail[0] = i+1;
+            trail_size = 1;
+            bool positive_OK = propagate(prob, work, trail, &trail_size, 0);
+            int positive_size = trail_size;
+            intAdeepCopy(positive_trail, trail, trail_size);
+            for (int k=0; k<positive_size; k++) {
+                implied[GET_INDEX(positive_trail[k])] = positive_trail[k];
+            }
+            undoTrail(work, trail, &trail_size, 0);
+
+            work[i] = -(i+1); // probing -v
+            trail[0] = -(i+1);
+            trail_size = 1;
+            bool negative_OK = propagate(prob, work, trail, &trail_size, 0);
+            int kept_from = trail_size; // trail entries from here on are kept as units
+            if (!positive_OK && !negative_OK) { // both polarities fail, so nothing extends model
+                undoTrail(work, trail, &trail_size, 0);
+                failed = i+1;
+                refuted = true;
+            } else if (!positive_OK) { // v is a failed literal: keeping -v and everything it implies
+                kept_from = 0;
+                changed = true;
+            } else if (!negative_OK) { // -v failed: redoing the positive side and keeping it
+                undoTrail(work, trail, &trail_size, 0);
+                work[i] = i+1;
+                trail[0] = i+1;
+                trail_size = 1;
+                propagate(prob, work, trail, &trail_size, 0); // succeeded a moment ago on the same assignment
+                kept_from = 0;
+                changed = true;
+            } else { // both fine: whatever both sides imply holds either way
+                int num_common = 0;
+                for (int k=1; k<trail_size; k++) {
+                    if (implied[GET_INDEX(trail[k])] == trail[k]) {
+                        common[num_common] = trail[k];
+                        num_common++;
+                    }
+                }
+                undoTrail(work, trail, &trail_size, 0);
+                for (int k=0; k<num_common; k++) {
+                    int lemma[2] = {common[k], -(i+1)}; // not(model) OR -v OR u, then not(model) OR v OR u, resolve to not(model) OR u
+                    proofLemma(proof, 'a', lemma, 2, model, prob.num_variables);
+                    lemma[1] = i+1;
+                    proofLemma(proof, 'a', lemma, 2, model, prob.num_variables);
+                    proofLemma(proof, 'a', lemma, 1, model, prob.num_variables);
+                    proofLemma(proof, 'd', lemma, 2, model, prob.num_variables);
+                    lemma[1] = -(i+1);
+                    proofLemma(proof, 'd', lemma, 2, model, prob.num_variables);
+                    work[GET_INDEX(common[k])] = common[k];
+                    trail[trail_size] = common[k];
+                    trail_size++;
+                    units[num_units] = common[k];
+                    num_units++;
+                }
+                kept_from = trail_size;
+                if (num_common > 0) {
+                    refuted = !propagate(prob, work, trail, &trail_size, 0);
+                    changed = true;
+                }
+                if (refuted) {
+                    undoTrail(work, trail, &trail_size, kept_from);
+                }
+            }
+            for (int k=kept_from; k<trail_size; k++) { // every kept literal is a unit under model
+                proofLemma(proof, 'a', &trail[k], 1, model, prob.num_variables);
+                units[num_units] = trail[k];
+                num_units++;
+            }
+            for (int k=0; k<positive_size; k++) { // clearing the positive probe's marks
+                implied[GET_INDEX(positive_trail[k])] = 0;
+            }
+        }
+    }
+    if (refuted) { // not(model) follows from the units so far; the units themselves are no longer needed
+        if (failed != 0) {
+            int lemma = -failed;
+            proofLemma(proof, 'a', &lemma, 1, model, prob.num_variables);
+        }
+        proofLemma(proof, 'a', NULL, 0, model, prob.num_variables);
+        if (failed != 0) {
+            int lemma = -failed;
+            proofLemma(proof, 'd', &lemma, 1, model, prob.num_variables);
+        }
+        for (int k=0; k<num_units; k++) {
+            proofLemma(proof, 'd', &units[k], 1, model, prob.num_variables);
+        }
+    }
+    return refuted ? -1 : num_units;
+}
+bool DPLL(SAT_problem prob, int *marked_clauses, int *symbols, int *model, int depth, search_state *state) { // recursive call
+    state->count++;
+    int *level = scratchLevel(prob, depth, state); // this node's copies; the children use the next level, so these stay intact until we return
+    if (level == NULL || pastDeadline(state)) { // unwinding the whole search once time (or memory) is up
+        return false;
+    }
     bool result;
-    int *this_symbols = malloc(sizeof(int) * prob.num_variables);
-    int *this_marked_clauses = malloc(sizeof(int) * prob.num_clauses);
-    int *this_model = malloc(sizeof(int) * prob.num_variables);
+    int *this_symbols = level;
+    int *this_model = level + prob.num_variables;
+    int *model1 = level + 2*prob.num_variables;
+    int *model2 = level + 3*prob.num_variables;
+    int *units = level + 4*prob.num_variables;
+    int *this_marked_clauses = level + 5*prob.num_variables;
     intAdeepCopy(this_symbols, symbols, prob.num_variables);
     intAdeepCopy(this_marked_clauses, marked_clauses, prob.num_clauses);
     intAdeepCopy(this_model, model, prob.num_variables);
@@ -161,173 +991,626 @@ bool DPLL(SAT_problem prob, int *marked_clauses, int *symbols, int *model, int *
     printf("Model: "); printArr(this_model, prob.num_variables); // debug */
    
     for (int i=0; i<prob.num_clauses; i++) { // checking if all clauses are SAT; if one UNSAT, return False
-        if (this_marked_clauses[i] == UNDET) { // need to check if this clause is SAT or not
-            int identifier = 0;
-            int num_false = 0;
-            int num_variables = 0;
-            for (int j=0; j<MAX_CLAUSE_LENGTH && prob.clauses[i][j] != 0 && identifier <= 0; j++) { // if one of the items here is true, whole statement is true
-                identifier = prob.clauses[i][j] * this_model[GET_INDEX(prob.clauses[i][j])]; // if unassigned, identifier will be 0; if opposites, identifier will be neg
-                if (identifier < 0) {
-                    num_false++;
-                }
-                num_variables++;
-            }
-            if (identifier > 0) {
+        if (this_marked_clauses[i] == UNDET) { // need to check if this clause is SAT or not; one at a time beats evaluateClauses() here since most are already marked and we stop at the first UNSAT
+            int status = clauseStatus(prob.clauses[i], this_model);
+            if (status == SAT) {
                 this_marked_clauses[i] = SAT;
-            } else if (num_false == num_variables) {
+            } else if (status == UNSAT) {
                 this_marked_clauses[i] = UNSAT;
                 // printf("Clause %d UNSAT\n", i); //debug
                 // printArr(prob.clauses[i], MAX_CLAUSE_LENGTH); //debug
-                free(this_symbols);
-                free(this_marked_clauses);
-                free(this_model);
+                proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables); // model falsifies clause i outright
                 return false;
             }
         } else if (this_marked_clauses[i] == UNSAT) {
-            free(this_symbols);
-            free(this_marked_clauses);
-            free(this_model);
+            proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables);
             return false;
         }
     }
-    bool all_SAT = true;
-    for (int i=0; i<prob.num_clauses && all_SAT != false; i++) {
-        if (this_marked_clauses[i] != SAT) {
-            // printf("Clause %d not SAT, actually %d\n", i, this_marked_clauses[i]); //debug
-            // printArr(prob.clauses[i], MAX_CLAUSE_LENGTH); //debug
-            all_SAT = false;
+    bool all_SAT = true;
+    for (int i=0; i<prob.num_clauses && all_SAT != false; i++) {
+        if (this_marked_clauses[i] != SAT) {
+            // printf("Clause %d not SAT, actually %d\n", i, this_marked_clauses[i]); //debug
+            // printArr(prob.clauses[i], MAX_CLAUSE_LENGTH); //debug
+            all_SAT = false;
+        }
+    }
+    if (all_SAT) {
+        intAdeepCopy(state->solution, this_model, prob.num_variables);
+        return true;
+    }
+    if (state->count % PROBE_INTERVAL == 0) { // periodically probing again, the assignments so far may have created new failed literals
+        int num_units = probeLiterals(prob, this_model, units, state); // on -1 the prober has already added not(model) to the proof
+        if (num_units != 0) {
+            for (int i=0; i<num_units; i++) {
+                this_symbols[GET_INDEX(units[i])] = 0; // removing symbol from remaining options
+                this_model[GET_INDEX(units[i])] = units[i]; // adding our assignment to the model
+            }
+            result = (num_units > 0) && DPLL(prob, this_marked_clauses, this_symbols, this_model, depth+1, state);
+            if (num_units > 0 && !result && !state->timed_out) { // not(model) from the probed units and the child's lemma, which we can then drop
+                proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables);
+                proofLemma(state->proof, 'd', NULL, 0, this_model, prob.num_variables);
+                for (int i=0; i<num_units; i++) {
+                    proofLemma(state->proof, 'd', &units[i], 1, model, prob.num_variables);
+                }
+            }
+            return result;
+        }
+    }
+    int *check = scratchWork(prob, state);
+    int value = (check != NULL) ? findPureSymbol(prob, this_marked_clauses, this_symbols, this_model, check) : 0;
+    if (value != 0) { // 0 indicates no symbol found, else a symbol will be returned in its pos/neg form
+        this_symbols[GET_INDEX(value)] = 0; // removing symbol from remaining options
+        this_model[GET_INDEX(value)] = value; // adding our assignment to the model
+        // printf("Pure symbol found: %d\n", value); //debug
+        proofLemma(state->proof, 'a', &value, 1, model, prob.num_variables); // RAT on the pure literal: every clause with its negation is already SAT
+        result = DPLL(prob, this_marked_clauses, this_symbols, this_model, depth+1, state); 
+        if (!result && !state->timed_out) {
+            proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables);
+            proofLemma(state->proof, 'd', NULL, 0, this_model, prob.num_variables);
+            proofLemma(state->proof, 'd', &value, 1, model, prob.num_variables);
+        }
+        return result;
+    }
+    
+    value = findUnitClause(prob, this_marked_clauses, this_symbols, this_model);
+    if (value != 0) {
+        this_symbols[GET_INDEX(value)] = 0; // removing symbol from remaining options
+        this_model[GET_INDEX(value)] = value; // adding our assignment to the model
+        // printf("Unit clause found: %d\n", value); //debug
+        result = DPLL(prob, this_marked_clauses, this_symbols, this_model, depth+1, state); 
+        if (!result && !state->timed_out) {
+            proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables);
+            proofLemma(state->proof, 'd', NULL, 0, this_model, prob.num_variables);
+        }
+        return result;
+    }
+
+    // otherwise, grab first symbol in symbols
+    int j = 0;
+    while (j<prob.num_variables && symbols[j] == 0) { // incrementing until first nonzero symbol found
+        j++;
+    }
+    int first = symbols[j];
+    // printf("Arbitrarily assigning: %d\n", first); //debug
+    this_symbols[j] = 0;
+    this_model[first-1] = first;
+    intAdeepCopy(model1, this_model, prob.num_variables); // creating two arrays to pass forward
+    this_model[first-1] = -first;
+    intAdeepCopy(model2, this_model, prob.num_variables);
+    result = DPLL(prob, this_marked_clauses, this_symbols, model1, depth+1, state) || DPLL(prob, this_marked_clauses, this_symbols, model2, depth+1, state);
+    if (!result && !state->timed_out) { // both children refuted, so model is too
+        proofLemma(state->proof, 'a', NULL, 0, model, prob.num_variables);
+        proofLemma(state->proof, 'd', NULL, 0, model1, prob.num_variables);
+        proofLemma(state->proof, 'd', NULL, 0, model2, prob.num_variables);
+    }
+    return result;
+}
+
+bool DPLLSolve(SAT_problem prob, search_state *state) { // returns True if solution (left in state->solution), returns False if not, out of time, or out of memory
+    int *level = scratchLevel(prob, 0, state); // the root's arrays; DPLL() starts at depth 1
+    if (level == NULL) {
+        return false;
+    }
+    int *symbols = level;
+    int *model = level + prob.num_variables;
+    int *units = level + 4*prob.num_variables;
+    int *marked_clauses = level + 5*prob.num_variables; // 0 for undetermined, -1 for false, 1 for true
+    for (int i=0; i<prob.num_variables; i++) {
+        model[i] = 0;
+        symbols[i] = i+1;
+    }
+    for (int j=0; j<prob.num_clauses; j++) {
+        marked_clauses[j] = UNDET;
+    }
+    int num_units = probeLiterals(prob, model, units, state); // collapsing what we can before the first branch
+    for (int i=0; i<num_units; i++) {
+        symbols[GET_INDEX(units[i])] = 0;
+        model[GET_INDEX(units[i])] = units[i];
+    }
+    bool result = (num_units != -1) && !state->timed_out && DPLL(prob, marked_clauses, symbols, model, 1, state);
+    if (num_units > 0 && !result && !state->timed_out) { // DPLL refuted the root units, which leaves the empty clause
+        proofLemma(state->proof, 'a', NULL, 0, NULL, 0);
+    }
+    return result;
+}
+bool DPLLSAT(SAT_problem prob, proof_writer *proof) { // returns True if solution, returns False if not (with a DRAT refutation in proof, if not NULL)
+    search_state state;
+    state.count = 1;
+    state.solution = malloc(sizeof(int) * prob.num_variables);
+    state.has_deadline = false;
+    state.timed_out = false;
+    state.out_of_memory = false;
+    state.proof = proof;
+    search_scratch scratch = {0};
+    state.scratch = &scratch;
+    state.scratch_limit = 0;
+    bool result = DPLLSolve(prob, &state);
+    if (state.out_of_memory) {
+        printf("error in malloc for search!\n");
+        exit(1);
+    }
+    if (result) {
+        printArr(state.solution, prob.num_variables);
+    }
+    freeScratch(&scratch);
+    free(state.solution);
+    printf("Nodes expanded: %d\n", state.count);
+    return result;
+}
+
+typedef struct { // arbitrary-precision unsigned integer for model counts
+    int size; // number of limbs in use, always at least 1
+    unsigned int *limbs; // base 2^32, least significant first
+} bignum;
+
+void bigInit(bignum *n, unsigned int value) {
+    n->size = 1;
+    n->limbs = malloc(sizeof(unsigned int));
+    if (n->limbs == NULL) {
+        printf("error in malloc for bignum!\n");
+        exit(1);
+    }
+    n->limbs[0] = value;
+}
+void bigFree(bignum *n) {
+    free(n->limbs);
+    n->limbs = NULL;
+    n->size = 0;
+}
+void bigTrim(bignum *n) { // dropping leading zero limbs
+    while (n->size > 1 && n->limbs[n->size-1] == 0) {
+        n->size--;
+    }
+}
+bool bigIsZero(bignum n) {
+    return n.size == 1 && n.limbs[0] == 0;
+}
+void bigCopy(bignum *dest, bignum src) {
+    dest->size = src.size;
+    dest->limbs = malloc(sizeof(unsigned int) * src.size);
+    if (dest->limbs == NULL) {
+        printf("error in malloc for bignum!\n");
+        exit(1);
+    }
+    memcpy(dest->limbs, src.limbs, sizeof(unsigned int) * src.size);
+}
+void bigAdd(bignum *dest, bignum src) { // dest += src
+    int size = (dest->size > src.size ? dest->size : src.size) + 1;
+    dest->limbs = realloc(dest->limbs, sizeof(unsigned int) * size);
+    if (dest->limbs == NULL) {
+        printf("error in realloc for bignum!\n");
+        exit(1);
+    }
+    for (int i=dest->size; i<size; i++) {
+        dest->limbs[i] = 0;
+    }
+    unsigned long long carry = 0;
+    for (int i=0; i<size; i++) {
+        carry += (unsigned long long) dest->limbs[i] + (i < src.size ? src.limbs[i] : 0);
+        dest->limbs[i] = (unsigned int) carry;
+        carry >>= 32;
+    }
+    dest->size = size;
+    bigTrim(dest);
+}
+void bigMultiply(bignum *dest, bignum src) { // dest *= src, schoolbook
+    int size = dest->size + src.size;
+    unsigned int *product = calloc(size, sizeof(unsigned int));
+    if (product == NULL) {
+        printf("error in calloc for bignum!\n");
+        exit(1);
+    }
+    for (int i=0; i<dest->size; i++) {
+        unsigned long long carry = 0;
+        for (int j=0; j<src.size; j++) {
+            carry += (unsigned long long) dest->limbs[i] * src.limbs[j] + product[i+j];
+            product[i+j] = (unsigned int) carry;
+            carry >>= 32;
+        }
+        product[i+src.size] = (unsigned int) carry;
+    }
+    free(dest->limbs);
+    dest->limbs = product;
+    dest->size = size;
+    bigTrim(dest);
+}
+void bigShift(bignum *n, int bits) { // n *= 2^bits, used for variables left free in a component
+    if (bits == 0 || bigIsZero(*n)) {
+        return;
+    }
+    int words = bits / 32;
+    int shift = bits % 32;
+    int size = n->size + words + 1;
+    unsigned int *shifted = calloc(size, sizeof(unsigned int));
+    if (shifted == NULL) {
+        printf("error in calloc for bignum!\n");
+        exit(1);
+    }
+    for (int i=0; i<n->size; i++) {
+        unsigned long long current = (unsigned long long) n->limbs[i] << shift;
+        shifted[i+words] |= (unsigned int) current;
+        shifted[i+words+1] |= (unsigned int) (current >> 32);
+    }
+    free(n->limbs);
+    n->limbs = shifted;
+    n->size = size;
+    bigTrim(n);
+}
+char *bigToString(bignum n) { // decimal representation, caller frees
+    bignum copy;
+    bigCopy(&copy, n);
+    char *digits = malloc(n.size*10 + 10); // a limb is under 10 decimal digits, plus one padded chunk of 9
+    if (digits == NULL) {
+        printf("error in malloc for bignum string!\n");
+        exit(1);
+    }
+    int length = 0;
+    do { // peeling off 9 decimal digits at a time, least significant first
+        unsigned long long remainder = 0;
+        for (int i=copy.size-1; i>=0; i--) {
+            unsigned long long current = (remainder << 32) | copy.limbs[i];
+            copy.limbs[i] = (unsigned int) (current / 1000000000);
+            remainder = current % 1000000000;
+        }
+        bigTrim(&copy);
+        for (int k=0; k<9; k++) {
+            digits[length] = '0' + remainder % 10;
+            remainder /= 10;
+            length++;
+        }
+    } while (!bigIsZero(copy));
+    while (length > 1 && digits[length-1] == '0') { // removing zero padding of the last chunk
+        length--;
+    }
+    for (int i=0; i<length/2; i++) { // reversing into reading order
+        char temp = digits[i];
+        digits[i] = digits[length-1-i];
+        digits[length-1-i] = temp;
+    }
+    digits[length] = '\0';
+    bigFree(&copy);
+    return digits;
+}
+
+typedef struct cache_entry { // a component count we have already solved
+    unsigned int hash;
+    int key_size;
+    int *key; // number of variables, then the sorted variable indices, then the sorted clause indices
+    bignum count;
+    struct cache_entry *next;
+} cache_entry;
+typedef struct {
+    int num_variables;
+    int *variables; // variable indices, ascending
+    int num_clauses;
+    int *clauses; // indices of clauses not yet SAT, ascending
+} component;
+typedef struct { // everything the model counter carries through its recursion
+    SAT_problem prob;
+    int *model;
+    int *trail;
+    int trail_size;
+    int *parent; // union-find over variables, -1 if variable not in any open clause
+    int *component_of; // component number of a union-find root, -1 otherwise
+    int *scores; // occurrence counts for picking the branching variable
+    cache_entry **cache;
+    size_t cache_bytes;
+    int nodes;
+    int cache_hits;
+    int cache_flushes;
+} model_counter;
+
+int findRoot(int *parent, int variable) {
+    while (parent[variable] != variable) {
+        parent[variable] = parent[parent[variable]]; // path halving
+        variable = parent[variable];
+    }
+    return variable;
+}
+void decompose(model_counter *counter, component comp, component **components, int *num_components, int *num_free) { // splits the still-open clauses of comp into variable-disjoint components
+    SAT_problem prob = counter->prob;
+    for (int i=0; i<comp.num_variables; i++) {
+        counter->parent[comp.variables[i]] = -1;
+    }
+    for (int i=0; i<comp.num_clauses; i++) { // unioning all unassigned variables of each open clause
+        int *clause = prob.clauses[comp.clauses[i]];
+        int first = -1;
+        bool clause_SAT = false;
+        for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0 && !clause_SAT; j++) {
+            clause_SAT = counter->model[GET_INDEX(clause[j])] == clause[j];
+        }
+        for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0 && !clause_SAT; j++) {
+            int variable = GET_INDEX(clause[j]);
+            if (counter->model[variable] != 0) {
+                continue;
+            }
+            if (counter->parent[variable] == -1) {
+                counter->parent[variable] = variable;
+            }
+            if (first == -1) {
+                first = variable;
+            } else {
+                counter->parent[findRoot(counter->parent, variable)] = findRoot(counter->parent, first);
+            }
+        }
+    }
+    *num_components = 0;
+    *num_free = 0;
+    for (int i=0; i<comp.num_variables; i++) { // numbering the roots
+        int variable = comp.variables[i];
+        if (counter->model[variable] != 0) {
+            continue;
+        }
+        if (counter->parent[variable] == -1) { // unassigned but in no open clause: either value works
+            (*num_free)++;
+            continue;
+        }
+        int root = findRoot(counter->parent, variable);
+        if (counter->component_of[root] == -1) {
+            counter->component_of[root] = *num_components;
+            (*num_components)++;
+        }
+    }
+    *components = calloc(*num_components + 1, sizeof(component));
+    if (*components == NULL) {
+        printf("error in calloc for components!\n");
+        exit(1);
+    }
+    for (int pass=0; pass<2; pass++) { // first pass sizes each component, second pass fills it
+        for (int i=0; i<*num_components; i++) {
+            if (pass == 1) {
+                (*components)[i].variables = malloc(sizeof(int) * ((*components)[i].num_variables + 1));
+                (*components)[i].clauses = malloc(sizeof(int) * ((*components)[i].num_clauses + 1));
+                if ((*components)[i].variables == NULL || (*components)[i].clauses == NULL) {
+                    printf("error in malloc for component!\n");
+                    exit(1);
+                }
+            }
+            (*components)[i].num_variables = 0;
+            (*components)[i].num_clauses = 0;
+        }
+        for (int i=0; i<comp.num_variables; i++) {
+            int variable = comp.variables[i];
+            if (counter->model[variable] == 0 && counter->parent[variable] != -1) {
+                component *target = &(*components)[counter->component_of[findRoot(counter->parent, variable)]];
+                if (pass == 1) {
+                    target->variables[target->num_variables] = variable;
+                }
+                target->num_variables++;
+            }
+        }
+        for (int i=0; i<comp.num_clauses; i++) {
+            int *clause = prob.clauses[comp.clauses[i]];
+            int first = -1;
+            bool clause_SAT = false;
+            for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0 && !clause_SAT; j++) {
+                clause_SAT = counter->model[GET_INDEX(clause[j])] == clause[j];
+                if (first == -1 && counter->model[GET_INDEX(clause[j])] == 0) {
+                    first = GET_INDEX(clause[j]);
+                }
+            }
+            if (!clause_SAT && first != -1) {
+                component *target = &(*components)[counter->component_of[findRoot(counter->parent, first)]];
+                if (pass == 1) {
+                    target->clauses[target->num_clauses] = comp.clauses[i];
+                }
+                target->num_clauses++;
+            }
+        }
+    }
+    for (int i=0; i<comp.num_variables; i++) { // leaving component_of clean for the next call
+        if (counter->model[comp.variables[i]] == 0 && counter->parent[comp.variables[i]] != -1) {
+            counter->component_of[findRoot(counter->parent, comp.variables[i])] = -1;
+        }
+    }
+}
+
+int *componentKey(component comp, int *key_size) {
+    *key_size = 1 + comp.num_variables + comp.num_clauses;
+    int *key = malloc(sizeof(int) * *key_size);
+    if (key == NULL) {
+        printf("error in malloc for cache key!\n");
+        exit(1);
+    }
+    key[0] = comp.num_variables;
+    intAdeepCopy(key + 1, comp.variables, comp.num_variables);
+    intAdeepCopy(key + 1 + comp.num_variables, comp.clauses, comp.num_clauses);
+    return key;
+}
+void flushCache(model_counter *counter) {
+    for (int i=0; i<CACHE_BUCKETS; i++) {
+        while (counter->cache[i] != NULL) {
+            cache_entry *entry = counter->cache[i];
+            counter->cache[i] = entry->next;
+            free(entry->key);
+            bigFree(&entry->count);
+            free(entry);
+        }
+    }
+    counter->cache_bytes = 0;
+}
+
+void countComponent(model_counter *counter, component comp, bignum *result);
+void countBranch(model_counter *counter, component comp, int literal, bignum *result) { // count of comp with literal set (0 for none), after propagation and decomposition
+    int trail_start = counter->trail_size;
+    if (literal != 0) {
+        counter->model[GET_INDEX(literal)] = literal;
+        counter->trail[counter->trail_size] = literal;
+        counter->trail_size++;
+    }
+    if (!propagate(counter->prob, counter->model, counter->trail, &counter->trail_size, trail_start)) {
+        undoTrail(counter->model, counter->trail, &counter->trail_size, trail_start);
+        bigInit(result, 0);
+        return;
+    }
+    component *components;
+    int num_components, num_free;
+    decompose(counter, comp, &components, &num_components, &num_free);
+    bigInit(result, 1);
+    bigShift(result, num_free);
+    for (int i=0; i<num_components; i++) {
+        if (!bigIsZero(*result)) { // once one component is UNSAT the product stays 0
+            bignum sub_count;
+            countComponent(counter, components[i], &sub_count);
+            bigMultiply(result, sub_count);
+            bigFree(&sub_count);
+        }
+        free(components[i].variables);
+        free(components[i].clauses);
+    }
+    free(components);
+    undoTrail(counter->model, counter->trail, &counter->trail_size, trail_start);
+}
+void countComponent(model_counter *counter, component comp, bignum *result) { // number of assignments to comp's variables that SAT its clauses
+    counter->nodes++;
+    int key_size;
+    int *key = componentKey(comp, &key_size);
+    unsigned int hash = hashKey(key, key_size);
+    for (cache_entry *entry = counter->cache[hash % CACHE_BUCKETS]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->key_size == key_size && memcmp(entry->key, key, sizeof(int) * key_size) == 0) {
+            counter->cache_hits++;
+            bigCopy(result, entry->count);
+            free(key);
+            return;
         }
     }
-    if (all_SAT) {
-        printArr(this_model, prob.num_variables);
-        free(this_symbols);
-        free(this_marked_clauses);
-        free(this_model);
-        return true;
+
+    int best = -1; // branching on the variable in the most open clauses of the component
+    for (int i=0; i<comp.num_clauses; i++) {
+        int *clause = counter->prob.clauses[comp.clauses[i]];
+        for (int j=0; j<MAX_CLAUSE_LENGTH && clause[j] != 0; j++) {
+            if (counter->model[GET_INDEX(clause[j])] == 0) {
+                counter->scores[GET_INDEX(clause[j])]++;
+            }
+        }
     }
-    int value = findPureSymbol(prob, this_marked_clauses, this_symbols, this_model);
-    if (value != 0) { // 0 indicates no symbol found, else a symbol will be returned in its pos/neg form
-        this_symbols[GET_INDEX(value)] = 0; // removing symbol from remaining options
-        this_model[GET_INDEX(value)] = value; // adding our assignment to the model
-        // printf("Pure symbol found: %d\n", value); //debug
-        result = DPLL(prob, this_marked_clauses, this_symbols, this_model, count); 
-        free(this_symbols);
-        free(this_marked_clauses);
-        free(this_model);
-        return result;
+    for (int i=0; i<comp.num_variables; i++) {
+        if (best == -1 || counter->scores[comp.variables[i]] > counter->scores[best]) {
+            best = comp.variables[i];
+        }
     }
-    
-    value = findUnitClause(prob, this_marked_clauses, this_symbols, this_model);
-    if (value != 0) {
-        this_symbols[GET_INDEX(value)] = 0; // removing symbol from remaining options
-        this_model[GET_INDEX(value)] = value; // adding our assignment to the model
-        // printf("Unit clause found: %d\n", value); //debug
-        result = DPLL(prob, this_marked_clauses, this_symbols, this_model, count); 
-        free(this_symbols);
-        free(this_marked_clauses);
-        free(this_model);
-        return result;
+    for (int i=0; i<comp.num_variables; i++) {
+        counter->scores[comp.variables[i]] = 0;
     }
 
-    // otherwise, grab first symbol in symbols
-    int j = 0;
-    while (j<prob.num_variables && symbols[j] == 0) { // incrementing until first nonzero symbol found
-        j++;
+    bignum branch;
+    countBranch(counter, comp, best+1, result);
+    countBranch(counter, comp, -(best+1), &branch);
+    bigAdd(result, branch);
+    bigFree(&branch);
+
+    size_t entry_bytes = sizeof(cache_entry) + sizeof(int) * key_size + sizeof(unsigned int) * result->size;
+    if (counter->cache_bytes + entry_bytes > (size_t) CACHE_BUDGET_MB * 1024 * 1024) { // over budget: start over rather than grow
+        flushCache(counter);
+        counter->cache_flushes++;
     }
-    int first = symbols[j];
-    // printf("Arbitrarily assigning: %d\n", first); //debug
-    this_symbols[j] = 0;
-    this_model[first-1] = first;
-    int *model1 = malloc(sizeof(int) * prob.num_variables);
-    intAdeepCopy(model1, this_model, prob.num_variables); // creating two arrays to pass forward
-    this_model[first-1] = -first;
-    int *model2 = malloc(sizeof(int) * prob.num_variables);
-    intAdeepCopy(model2, this_model, prob.num_variables);
-    result = DPLL(prob, this_marked_clauses, this_symbols, model1, count) || DPLL(prob, this_marked_clauses, this_symbols, model2, count);
-    free(this_symbols);
-    free(this_marked_clauses);
-    free(this_model);
-    free(model1);
-    free(model2);
-    return result;
+    cache_entry *entry = malloc(sizeof(cache_entry));
+    if (entry == NULL) {
+        printf("error in malloc for cache entry!\n");
+        exit(1);
+    }
+    entry->hash = hash;
+    entry->key_size = key_size;
+    entry->key = key;
+    bigCopy(&entry->count, *result);
+    entry->next = counter->cache[hash % CACHE_BUCKETS];
+    counter->cache[hash % CACHE_BUCKETS] = entry;
+    counter->cache_bytes += entry_bytes;
 }
 
-bool DPLLSAT(SAT_problem prob) { // returns True if solution, returns False if not
-    int count = 1;
-    int *cptr = &count;
-    int *model = malloc(sizeof(int) * prob.num_variables);
-    int *symbols = malloc(sizeof(int) * prob.num_variables);
-    int *marked_clauses = malloc(sizeof(int) * prob.num_clauses); // 0 for undetermined, -1 for false, 1 for true
+void modelCountSAT(SAT_problem prob, bignum *result) { // exact number of satisfying assignments (#SAT)
+    model_counter counter;
+    counter.prob = prob;
+    counter.model = calloc(prob.num_variables + 1, sizeof(int));
+    counter.trail = malloc(sizeof(int) * (prob.num_variables + 1));
+    counter.parent = malloc(sizeof(int) * (prob.num_variables + 1));
+    counter.component_of = malloc(sizeof(int) * (prob.num_variables + 1));
+    counter.scores = calloc(prob.num_variables + 1, sizeof(int));
+    counter.cache = calloc(CACHE_BUCKETS, sizeof(cache_entry *));
+    if (counter.model == NULL || counter.trail == NULL || counter.parent == NULL || counter.component_of == NULL || counter.scores == NULL || counter.cache == NULL) {
+        printf("error in malloc for model counter!\n");
+        exit(1);
+    }
     for (int i=0; i<prob.num_variables; i++) {
-        model[i] = 0;
-        symbols[i] = i+1;
+        counter.component_of[i] = -1;
     }
-    for (int j=0; j<prob.num_clauses; j++) {
-        marked_clauses[j] = UNDET;
+    counter.trail_size = 0;
+    counter.cache_bytes = 0;
+    counter.nodes = 0;
+    counter.cache_hits = 0;
+    counter.cache_flushes = 0;
+
+    component root;
+    root.num_variables = prob.num_variables;
+    root.variables = malloc(sizeof(int) * (prob.num_variables + 1));
+    root.num_clauses = prob.num_clauses;
+    root.clauses = malloc(sizeof(int) * (prob.num_clauses + 1));
+    if (root.variables == NULL || root.clauses == NULL) {
+        printf("error in malloc for root component!\n");
+        exit(1);
     }
-    bool result = DPLL(prob, marked_clauses, symbols, model, cptr);
-    free(model);
-    free(symbols);
-    free(marked_clauses);
-    printf("Nodes expanded: %d\n", count);
-    return result;
+    for (int i=0; i<prob.num_variables; i++) {
+        root.variables[i] = i;
+    }
+    for (int i=0; i<prob.num_clauses; i++) {
+        root.clauses[i] = i;
+    }
+
+    bool conflict = false;
+    for (int i=0; i<prob.num_clauses && !conflict; i++) { // unit clauses never get visited by propagate(), so assigning them up front
+        if (prob.clauses[i][0] == 0) { // empty clause
+            conflict = true;
+        } else if (prob.clauses[i][1] == 0) {
+            int literal = prob.clauses[i][0];
+            if (counter.model[GET_INDEX(literal)] == -literal) {
+                conflict = true;
+            } else if (counter.model[GET_INDEX(literal)] == 0) {
+                counter.model[GET_INDEX(literal)] = literal;
+                counter.trail[counter.trail_size] = literal;
+                counter.trail_size++;
+            }
+        }
+    }
+    if (conflict || !propagate(prob, counter.model, counter.trail, &counter.trail_size, 0)) {
+        bigInit(result, 0);
+    } else {
+        countBranch(&counter, root, 0, result);
+    }
+    printf("Components expanded: %d, cache hits: %d, cache flushes: %d\n", counter.nodes, counter.cache_hits, counter.cache_flushes);
+
+    flushCache(&counter);
+    free(root.variables);
+    free(root.clauses);
+    free(counter.model);
+    free(counter.trail);
+    free(counter.parent);
+    free(counter.component_of);
+    free(counter.scores);
+    free(counter.cache);
 }
 
-bool checkModelSAT(SAT_problem prob, int *marked_clauses, int *model) {
+bool checkModelSAT(SAT_problem prob, int *marked_clauses, int *model, unsigned int *sat_bitmap, unsigned int *unsat_bitmap) { // bitmaps are BITMAP_WORDS(num_slots) words of scratch from the caller
     bool isSAT = true;
+    evaluateClauses(prob, model, sat_bitmap, unsat_bitmap);
     for (int i=0; i<prob.num_clauses; i++) { // checking if all clauses are SAT; if one UNSAT, return False
-        int identifier = 0;
-        int num_false = 0;
-        int num_variables = 0;
-        for (int j=0; j<MAX_CLAUSE_LENGTH && prob.clauses[i][j] != 0 && identifier <= 0; j++) { // if one of the items here is true, whole statement is true
-            identifier = prob.clauses[i][j] * model[GET_INDEX(prob.clauses[i][j])]; // if opposites, identifier will be neg
-            if (identifier < 0) {
-                num_false++;
-            }
-            num_variables++;
-        }
-        if (identifier > 0) {
+        if (TEST_BIT(sat_bitmap, i)) {
             marked_clauses[i] = SAT;
-        } else if (num_false == num_variables) {
+        } else if (TEST_BIT(unsat_bitmap, i)) {
             marked_clauses[i] = UNSAT;
             isSAT = false;
         }
     }
     return isSAT;
 }
-int countSATclauses(SAT_problem prob, int *marked_clauses, int *model, int variable) { // if variable=0, just count; else check flipping that variable
-    int counter = 0;
-    int *this_marked_clauses = malloc(sizeof(int) * prob.num_clauses);
-    int *this_model = malloc(sizeof(int) * prob.num_variables);
-    intAdeepCopy(this_marked_clauses, marked_clauses, prob.num_clauses);
-    intAdeepCopy(this_model, model, prob.num_variables);
+int countSATclauses(SAT_problem prob, int *model, int variable) { // if variable=0, just count; else check flipping that variable
     if (variable != 0) {
-        this_model[GET_INDEX(variable)] *= -1;
+        model[GET_INDEX(variable)] *= -1;
     }
-    for (int i=0; i<prob.num_clauses; i++) { // updating clauses with the chosen variable
-        int identifier      = 0;
-        int num_false       = 0;
-        int num_variables   = 0;
-        for (int j=0; j<MAX_CLAUSE_LENGTH && prob.clauses[i][j] != 0 && identifier <= 0; j++) { // if one of the items here is true, whole statement is true
-            identifier = prob.clauses[i][j] * this_model[GET_INDEX(prob.clauses[i][j])]; // if opposites, identifier will be neg
-            if (identifier < 0) {
-                num_false++;
-            }
-            num_variables++;
-        }
-        if (identifier > 0) {
-            this_marked_clauses[i] = SAT;
-        } else if (num_false == num_variables) {
-            this_marked_clauses[i] = UNSAT;
-        }
+    int counter = evaluateClauses(prob, model, NULL, NULL);
+    if (variable != 0) { // putting the model back the way we found it
+        model[GET_INDEX(variable)] *= -1;
     }
-    for (int i=0; i<prob.num_clauses; i++) {
-            if (this_marked_clauses[i] == 1) {
-                counter++;
-            }
-        }
-    free(this_marked_clauses);
-    free(this_model);
     return counter;
 }
 
@@ -341,16 +1624,24 @@ int WalkSAT(SAT_problem prob, float p, int max_flips) { // returns c, the number
     }
     //printArr(model, prob.num_variables); //debug
     int *marked_clauses = malloc(sizeof(int) * prob.num_clauses); // -1 false, 1 true
+    unsigned int *sat_bitmap = malloc(sizeof(unsigned int) * BITMAP_WORDS(prob.num_slots) + 1); // once per run rather than once per flip
+    unsigned int *unsat_bitmap = malloc(sizeof(unsigned int) * BITMAP_WORDS(prob.num_slots) + 1);
+    if (sat_bitmap == NULL || unsat_bitmap == NULL) {
+        printf("error in malloc for clause bitmaps!\n");
+        exit(1);
+    }
     for (int i=0; i<max_flips; i++) {
-        if (checkModelSAT(prob, marked_clauses, model)) {
+        if (checkModelSAT(prob, marked_clauses, model, sat_bitmap, unsat_bitmap)) {
             printArr(model, prob.num_variables);
             printf("Solution found in %d flips out of %d.\n", i+1, max_flips);
             free(maxSATArr);
             free(model);
             free(marked_clauses);
+            free(sat_bitmap);
+            free(unsat_bitmap);
             return prob.num_clauses; // number of clauses satisfied
         } else {
-            int current_count_SAT = countSATclauses(prob, marked_clauses, model, 0);
+            int current_count_SAT = countSATclauses(prob, model, 0);
             if (max_SAT < current_count_SAT) {
                 //printf("New max: %d > %d\n", current_count_SAT, max_SAT); //debug
                 max_SAT = current_count_SAT;
@@ -377,7 +1668,7 @@ int WalkSAT(SAT_problem prob, float p, int max_flips) { // returns c, the number
             int max_count = -1;
             int max_count_variable = 0;
             for (int j=0; j<num_variables_in_clause; j++) {
-                int curr_count = countSATclauses(prob, marked_clauses, model, selected_clause[j]);
+                int curr_count = countSATclauses(prob, model, selected_clause[j]);
                 if (curr_count > max_count) {
                     max_count = curr_count;
                     max_count_variable = selected_clause[j];
@@ -393,6 +1684,8 @@ int WalkSAT(SAT_problem prob, float p, int max_flips) { // returns c, the number
     free(maxSATArr);
     free(model);
     free(marked_clauses);
+    free(sat_bitmap);
+    free(unsat_bitmap);
     return max_SAT;
 }
 
@@ -672,24 +1965,771 @@ void qsortParallelLists(char **population, int pop_size, int fitnesses[], int lo
 }
  */
 
-int main(int argc, char *argv[]) { // call this program with */*.cnf
+typedef struct { // clauses the DRAT checker currently believes
+    int num_clauses;
+    int capacity;
+    int **clauses; // literals as given, so a lemma's RAT pivot stays first
+    int **sorted; // same literals sorted, for matching deletions
+    int *sizes;
+    unsigned int *hashes; // hashKey() of sorted
+    bool *active;
+} clause_db;
+
+int intComparator(const void *a, const void *b) {
+    return (*(int*) a > *(int*) b) - (*(int*) a < *(int*) b);
+}
+void dbAdd(clause_db *db, int *literals, int size) {
+    if (db->num_clauses == db->capacity) {
+        db->capacity = db->capacity * 2 + 64;
+        db->clauses = realloc(db->clauses, sizeof(int *) * db->capacity);
+        db->sorted = realloc(db->sorted, sizeof(int *) * db->capacity);
+        db->sizes = realloc(db->sizes, sizeof(int) * db->capacity);
+        db->hashes = realloc(db->hashes, sizeof(unsigned int) * db->capacity);
+        db->active = realloc(db->active, sizeof(bool) * db->capacity);
+        if (db->clauses == NULL || db->sorted == NULL || db->sizes == NULL || db->hashes == NULL || db->active == NULL) {
+            printf("error in realloc for clause database!\n");
+            exit(1);
+        }
+    }
+    int i = db->num_clauses;
+    db->clauses[i] = malloc(sizeof(int) * (size + 1));
+    db->sorted[i] = malloc(sizeof(int) * (size + 1));
+    if (db->clauses[i] == NULL || db->sorted[i] == NULL) {
+        printf("error in malloc for checker clause!\n");
+        exit(1);
+    }
+    intAdeepCopy(db->clauses[i], literals, size);
+    intAdeepCopy(db->sorted[i], literals, size);
+    qsort(db->sorted[i], size, sizeof(int), intComparator);
+    db->sizes[i] = size;
+    db->hashes[i] = hashKey(db->sorted[i], size);
+    db->active[i] = true;
+    db->num_clauses++;
+}
+bool dbDelete(clause_db *db, int *literals, int size) { // deactivates one active copy of the clause; false if there is none
+    qsort(literals, size, sizeof(int), intComparator);
+    unsigned int hash = hashKey(literals, size);
+    for (int i=db->num_clauses-1; i>=0; i--) { // lemmas tend to be deleted soon after they are added
+        if (db->active[i] && db->hashes[i] == hash && db->sizes[i] == size && memcmp(db->sorted[i], literals, sizeof(int) * size) == 0) {
+            db->active[i] = false;
+            return true;
+        }
+    }
+    return false;
+}
+bool propagatesToConflict(clause_db *db, int *values) { // unit propagation over the active clauses; values[v] is 1, -1 or 0
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i=0; i<db->num_clauses; i++) {
+            if (!db->active[i]) {
+                continue;
+            }
+            bool clause_SAT = false;
+            int num_unassigned = 0;
+            int unassigned_variable = 0;
+            for (int j=0; j<db->sizes[i] && !clause_SAT; j++) {
+                int value = values[abs(db->clauses[i][j])] * (db->clauses[i][j] > 0 ? 1 : -1);
+                if (value > 0) {
+                    clause_SAT = true;
+                } else if (value == 0) {
+                    num_unassigned++;
+                    unassigned_variable = db->clauses[i][j];
+                }
+            }
+            if (clause_SAT) {
+                continue;
+            }
+            if (num_unassigned == 0) {
+                return true;
+            }
+            if (num_unassigned == 1) {
+                values[abs(unassigned_variable)] = unassigned_variable > 0 ? 1 : -1;
+                changed = true;
+            }
+        }
+    }
+    return false;
+}
+bool isRUP(clause_db *db, int *values, int num_variables, int *literals, int size) { // reverse unit propagation: falsifying the clause must lead to a conflict
+    for (int v=0; v<=num_variables; v++) {
+        values[v] = 0;
+    }
+    for (int j=0; j<size; j++) {
+        int negation = literals[j] > 0 ? -1 : 1;
+        if (values[abs(literals[j])] == -negation) { // clause contains both x and -x
+            return true;
+        }
+        values[abs(literals[j])] = negation;
+    }
+    return propagatesToConflict(db, values);
+}
+bool isRAT(clause_db *db, int *values, int num_variables, int *literals, int size) { // every resolvent on the first literal must be RUP
+    if (size == 0) {
+        return false;
+    }
+    int pivot = literals[0];
+    int longest = 0;
+    for (int i=0; i<db->num_clauses; i++) {
+        longest = db->sizes[i] > longest ? db->sizes[i] : longest;
+    }
+    int *resolvent = malloc(sizeof(int) * (size + longest + 1));
+    if (resolvent == NULL) {
+        printf("error in malloc for resolvent!\n");
+        exit(1);
+    }
+    bool result = true;
+    int num_clauses = db->num_clauses; // resolving only against clauses present before this lemma
+    for (int i=0; i<num_clauses && result; i++) {
+        bool has_negated_pivot = false;
+        for (int j=0; j<db->sizes[i] && db->active[i]; j++) {
+            has_negated_pivot = has_negated_pivot || db->clauses[i][j] == -pivot;
+        }
+        if (!has_negated_pivot) {
+            continue;
+        }
+        int resolvent_size = 0;
+        for (int j=0; j<size; j++) {
+            resolvent[resolvent_size] = literals[j];
+            resolvent_size++;
+        }
+        for (int j=0; j<db->sizes[i]; j++) {
+            if (db->clauses[i][j] != -pivot) {
+                resolvent[resolvent_size] = db->clauses[i][j];
+                resolvent_size++;
+            }
+        }
+        result = isRUP(db, values, num_variables, resolvent, resolvent_size);
+    }
+    free(resolvent);
+    return result;
+}
+bool checkProof(SAT_problem prob, char *proof_filename) { // forward-checks a binary DRAT refutation of prob
+    FILE *input = fopen(proof_filename, "rb");
+    if (input == NULL) {
+        printf("%s not found.\n", proof_filename);
+        return false;
+    }
+    fseek(input, 0, SEEK_END);
+    size_t size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    unsigned char *proof = malloc(size + 1);
+    if (proof == NULL || fread(proof, 1, size, input) != size) {
+        printf("could not read %s.\n", proof_filename);
+        exit(1);
+    }
+    fclose(input);
+
+    clause_db db = {0};
+    for (int i=0; i<prob.num_clauses; i++) {
+        int length = 0;
+        while (length < MAX_CLAUSE_LENGTH && prob.clauses[i][length] != 0) {
+            length++;
+        }
+        dbAdd(&db, prob.clauses[i], length);
+    }
+    int *values = calloc(prob.num_variables + 1, sizeof(int));
+    int *literals = malloc(sizeof(int) * 1024);
+    int literals_capacity = 1024;
+    if (values == NULL || literals == NULL) {
+        printf("error in malloc for checker!\n");
+        exit(1);
+    }
+    bool valid = true;
+    bool refuted = false;
+    int num_lemmas = 0;
+    int num_deletions = 0;
+    size_t position = 0;
+    while (position < size && valid && !refuted) {
+        unsigned char kind = proof[position];
+        position++;
+        int num_literals = 0;
+        while (true) { // reading varint-encoded literals up to the terminating 0
+            unsigned int encoded = 0;
+            int shift = 0;
+            while (position < size && (proof[position] & 128)) {
+                encoded |= (unsigned int) (proof[position] & 127) << shift;
+                shift += 7;
+                position++;
+            }
+            if (position == size) {
+                valid = false;
+                break;
+            }
+            encoded |= (unsigned int) proof[position] << shift;
+            position++;
+            if (encoded == 0) {
+                break;
+            }
+            int literal = (encoded & 1) ? -(int) (encoded >> 1) : (int) (encoded >> 1);
+            if (abs(literal) > prob.num_variables || literal == 0) {
+                valid = false;
+                break;
+            }
+            if (num_literals == literals_capacity) {
+                literals_capacity *= 2;
+                literals = realloc(literals, sizeof(int) * literals_capacity);
+                if (literals == NULL) {
+                    printf("error in realloc for checker!\n");
+                    exit(1);
+                }
+            }
+            literals[num_literals] = literal;
+            num_literals++;
+        }
+        if (!valid) {
+            printf("Proof is truncated or malformed after %d lemmas.\n", num_lemmas);
+        } else if (kind == 'a') {
+            num_lemmas++;
+            if (!isRUP(&db, values, prob.num_variables, literals, num_literals)
+                && !isRAT(&db, values, prob.num_variables, literals, num_literals)) {
+                printf("Lemma %d is neither RUP nor RAT.\n", num_lemmas);
+                valid = false;
+            } else if (num_literals == 0) {
+                refuted = true;
+            } else {
+                dbAdd(&db, literals, num_literals);
+            }
+        } else if (kind == 'd') {
+            num_deletions++;
+            dbDelete(&db, literals, num_literals); // deleting a clause we never had cannot make the proof unsound
+        } else {
+            printf("Unknown proof step '%c'.\n", kind);
+            valid = false;
+        }
+    }
+    if (valid && refuted) {
+        printf("Proof verified: %d lemmas, %d deletions.\n", num_lemmas, num_deletions);
+    } else if (valid) {
+        printf("Proof never derives the empty clause.\n");
+    }
+    for (int i=0; i<db.num_clauses; i++) {
+        free(db.clauses[i]);
+        free(db.sorted[i]);
+    }
+    free(db.clauses);
+    free(db.sorted);
+    free(db.sizes);
+    free(db.hashes);
+    free(db.active);
+    free(values);
+    free(literals);
+    free(proof);
+    return valid && refuted;
+}
+
+volatile sig_atomic_t daemon_stop = 0;
+void stopDaemon(int signal_number) {
+    daemon_stop = 1;
+}
+
+typedef struct { // accepted connections waiting for a worker, plus the latencies of finished ones
+    int fds[DAEMON_QUEUE];
+    struct timespec accepted[DAEMON_QUEUE]; // when each connection was accepted
+    int head;
+    int size;
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    double latencies[LATENCY_SAMPLES]; // ms from accept to response written, a ring of the most recent requests
+    long num_latencies; // total requests served, may exceed LATENCY_SAMPLES
+} daemon_queue;
+daemon_queue server;
+
+double elapsedMs(struct timespec start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+int doubleComparator(const void *a, const void *b) {
+    double casted_a = *(double*) a;
+    double casted_b = *(double*) b;
+    return casted_a < casted_b ? -1 : casted_a > casted_b ? 1 : 0;
+}
+void formatLatencies(char *buffer, size_t size, double *latencies, int count) { // sorts latencies in place
+    if (count == 0) {
+        snprintf(buffer, size, "Latency: no requests yet.\n");
+        return;
+    }
+    qsort(latencies, count, sizeof(double), doubleComparator);
+    snprintf(buffer, size, "Latency over %d requests (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+        count, latencies[count/2], latencies[count*9/10], latencies[count*99/100], latencies[count-1]);
+}
+bool waitFor(int fd, short events, struct timespec start, int timeout_ms) { // polls fd until events or timeout_ms after start (-1 waits forever)
+    while (true) {
+        struct pollfd ready = {fd, events, 0};
+        int remaining_ms = (timeout_ms < 0) ? -1 : timeout_ms - (int) elapsedMs(start); // one deadline for the whole transfer, so trickling bytes does not extend it
+        if (timeout_ms >= 0 && remaining_ms <= 0) {
+            return false;
+        }
+        int result = poll(&ready, 1, remaining_ms);
+        if (result > 0) {
+            return true;
+        }
+        if (result == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+bool writeAll(int fd, char *buffer, size_t size, int timeout_ms) { // false on error or if the peer does not take it all within timeout_ms (-1 waits forever)
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (size > 0) {
+        if (!waitFor(fd, POLLOUT, start, timeout_ms)) {
+            return false;
+        }
+        ssize_t written = send(fd, buffer, size, MSG_DONTWAIT); // never blocking past the deadline, even when size is more than the socket buffer takes
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        buffer += written;
+        size -= written;
+    }
+    return true;
+}
+bool readAll(int fd, char **buffer, size_t *capacity, size_t *size, int timeout_ms) { // reads until the peer shuts down its side, growing *buffer as needed; false if that takes over timeout_ms (-1 waits forever)
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    *size = 0;
+    while (true) {
+        if (*size + 4096 > *capacity) {
+            if (!growArray((void **) buffer, (*capacity + 4096) * 2)) { // the daemon answers "s ERROR" rather than exiting
+                printf("error in realloc for request buffer!\n");
+                return false;
+            }
+            *capacity = (*capacity + 4096) * 2;
+        }
+        if (!waitFor(fd, POLLIN, start, timeout_ms)) {
+            return false;
+        }
+        ssize_t received = read(fd, *buffer + *size, *capacity - *size - 1);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0) {
+            return false;
+        }
+        if (received == 0) {
+            (*buffer)[*size] = '\0';
+            return true;
+        }
+        *size += received;
+    }
+}
+
+typedef struct { // what a worker keeps between requests so it does not reallocate for every formula
+    char *request;
+    size_t request_capacity;
+    char *response;
+    size_t response_capacity;
+    SAT_problem prob; // parsed DIMACS requests reuse these arrays
+    int *solution;
+    int solution_capacity;
+    search_scratch scratch; // DPLL's per-depth arrays, reused by the next request
+} daemon_worker;
+
+bool handleRequest(daemon_worker *worker, int fd) { // solves one request; false if it was not a solve request
+    size_t size;
+    if (!readAll(fd, &worker->request, &worker->request_capacity, &size, DAEMON_IO_TIMEOUT_MS)) { // idle or trickling clients would otherwise hold a worker forever
+        writeAll(fd, "s ERROR\n", 8, DAEMON_IO_TIMEOUT_MS);
+        return false;
+    }
+    if (strncmp(worker->request, "STATS", 5) == 0) {
+        pthread_mutex_lock(&server.lock);
+        int count = server.num_latencies < LATENCY_SAMPLES ? server.num_latencies : LATENCY_SAMPLES;
+        double *latencies = malloc(sizeof(double) * count + 1);
+        if (latencies == NULL) {
+            pthread_mutex_unlock(&server.lock);
+            writeAll(fd, "s ERROR\n", 8, DAEMON_IO_TIMEOUT_MS);
+            return false;
+        }
+        memcpy(latencies, server.latencies, sizeof(double) * count);
+        pthread_mutex_unlock(&server.lock);
+        char stats[256];
+        formatLatencies(stats, sizeof(stats), latencies, count);
+        free(latencies);
+        writeAll(fd, stats, strlen(stats), DAEMON_IO_TIMEOUT_MS);
+        return false;
+    }
+
+    int timeout_ms = DAEMON_TIMEOUT_MS;
+    if (strncmp(worker->request, "c timeout ", 10) == 0) { // still a DIMACS comment, so the rest parses as usual
+        char *end;
+        long requested = strtol(worker->request + 10, &end, 10);
+        if (end == worker->request + 10 || requested < 0) {
+            writeAll(fd, "s ERROR\n", 8, DAEMON_IO_TIMEOUT_MS);
+            return true;
+        }
+        timeout_ms = (requested > DAEMON_MAX_TIMEOUT_MS) ? DAEMON_MAX_TIMEOUT_MS : requested; // a client cannot pin a worker for longer than this
+    }
+    SAT_problem image_prob;
+    SAT_problem *prob = &worker->prob;
+    bool valid;
+    bool from_image = size >= sizeof(image_header) && memcmp(worker->request, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0;
+    if (from_image) { // binary form, solved straight out of the request buffer
+        valid = problemFromImage(worker->request, size, false, &image_prob);
+        prob = &image_prob;
+    } else {
+        FILE *input = fmemopen(worker->request, size + 1, "r");
+        valid = input != NULL && parseDIMACS(input, &worker->prob, size);
+        if (input != NULL) {
+            fclose(input);
+        }
+    }
+    if (!valid) {
+        writeAll(fd, "s ERROR\n", 8, DAEMON_IO_TIMEOUT_MS);
+        return true;
+    }
+
+    if (prob->num_variables > worker->solution_capacity) {
+        if (!growArray((void **) &worker->solution, sizeof(int) * (size_t) prob->num_variables)
+            || !growArray((void **) &worker->response, 32 + 12 * (size_t) prob->num_variables)) { // "s SATISFIABLE\nv " plus one int per variable
+            printf("error in realloc for solution!\n");
+            writeAll(fd, "s ERROR\n", 8, DAEMON_IO_TIMEOUT_MS);
+            if (from_image) {
+                free(image_prob.clauses);
+            }
+            return true;
+        }
+        worker->solution_capacity = prob->num_variables;
+        worker->response_capacity = 32 + 12 * (size_t) prob->num_variables;
+    }
+    search_state state;
+    state.count = 1;
+    state.solution = worker->solution;
+    state.has_deadline = true;
+    state.timed_out = false;
+    state.out_of_memory = false;
+    state.proof = NULL;
+    state.scratch = &worker->scratch;
+    state.scratch_limit = (size_t) DAEMON_SCRATCH_MB << 20;
+    clock_gettime(CLOCK_MONOTONIC, &state.deadline);
+    state.deadline.tv_sec += timeout_ms / 1000;
+    state.deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (state.deadline.tv_nsec >= 1000000000L) {
+        state.deadline.tv_sec++;
+        state.deadline.tv_nsec -= 1000000000L;
+    }
+
+    int length;
+    if (DPLLSolve(*prob, &state)) {
+        length = sprintf(worker->response, "s SATISFIABLE\nv");
+        for (int i=0; i<prob->num_variables; i++) {
+            if (state.solution[i] != 0) { // unassigned variables can take either value
+                length += sprintf(worker->response + length, " %d", state.solution[i]);
+            }
+        }
+        length += sprintf(worker->response + length, " 0\n");
+    } else {
+        length = sprintf(worker->response, state.out_of_memory ? "s ERROR\n" : state.timed_out ? "s UNKNOWN\n" : "s UNSATISFIABLE\n");
+    }
+    writeAll(fd, worker->response, length, DAEMON_IO_TIMEOUT_MS); // a client that never reads its answer cannot hold the worker
+    if (from_image) {
+        free(image_prob.clauses);
+    }
+    return true;
+}
+void *daemonWorker(void *arg) {
+    daemon_worker worker = {0};
+    while (true) {
+        pthread_mutex_lock(&server.lock);
+        while (server.size == 0 && !server.stopping) {
+            pthread_cond_wait(&server.not_empty, &server.lock);
+        }
+        if (server.size == 0) { // stopping and nothing left to serve
+            pthread_mutex_unlock(&server.lock);
+            break;
+        }
+        int fd = server.fds[server.head];
+        struct timespec accepted = server.accepted[server.head];
+        server.head = (server.head + 1) % DAEMON_QUEUE;
+        server.size--;
+        pthread_cond_signal(&server.not_full);
+        pthread_mutex_unlock(&server.lock);
+
+        bool solved = handleRequest(&worker, fd);
+        if (solved) { // before close(), so a client that asks for STATS once its answer arrives sees this request counted
+            double latency = elapsedMs(accepted);
+            pthread_mutex_lock(&server.lock);
+            server.latencies[server.num_latencies % LATENCY_SAMPLES] = latency;
+            server.num_latencies++;
+            pthread_mutex_unlock(&server.lock);
+        }
+        close(fd);
+        trimScratch(&worker.scratch, (size_t) DAEMON_SCRATCH_KEEP_MB << 20); // one deep search should not pin its levels to this worker for good
+    }
+    freeProblem(worker.prob);
+    freeScratch(&worker.scratch);
+    free(worker.request);
+    free(worker.response);
+    free(worker.solution);
+    return NULL;
+}
+int runDaemon(char *socket_path) { // serves DPLL requests on a Unix socket until SIGINT/SIGTERM
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("Socket path %s is too long.\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path); // left over from a previous run
+    if (listener == -1 || bind(listener, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(listener, DAEMON_QUEUE) == -1) {
+        perror("could not listen on socket");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopDaemon; // no SA_RESTART, so accept() returns and we notice
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN); // a client hanging up early should not kill the daemon
+
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.not_empty, NULL);
+    pthread_cond_init(&server.not_full, NULL);
+    server.head = 0;
+    server.size = 0;
+    server.stopping = false;
+    server.num_latencies = 0;
+    int num_workers = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    pthread_t *workers = malloc(sizeof(pthread_t) * num_workers);
+    for (int i=0; i<num_workers; i++) {
+        pthread_create(&workers[i], NULL, daemonWorker, NULL);
+    }
+    printf("Listening on %s with %d workers.\n", socket_path, num_workers);
+    fflush(stdout);
+
+    while (!daemon_stop) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd == -1) {
+            continue; // EINTR from our signal, or a client that went away
+        }
+        pthread_mutex_lock(&server.lock);
+        while (server.size == DAEMON_QUEUE) {
+            pthread_cond_wait(&server.not_full, &server.lock);
+        }
+        server.fds[(server.head + server.size) % DAEMON_QUEUE] = fd;
+        clock_gettime(CLOCK_MONOTONIC, &server.accepted[(server.head + server.size) % DAEMON_QUEUE]);
+        server.size++;
+        pthread_cond_signal(&server.not_empty);
+        pthread_mutex_unlock(&server.lock);
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.not_empty);
+    pthread_mutex_unlock(&server.lock);
+    for (int i=0; i<num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    close(listener);
+    unlink(socket_path);
+    char stats[256];
+    int count = server.num_latencies < LATENCY_SAMPLES ? server.num_latencies : LATENCY_SAMPLES;
+    formatLatencies(stats, sizeof(stats), server.latencies, count);
+    printf("%s", stats);
+    return 0;
+}
+
+typedef struct { // one load generator connection loop
+    char *socket_path;
+    char *payload;
+    size_t payload_size;
+    int num_requests;
+    double *latencies;
+    int outcomes[4]; // SAT, UNSAT, UNKNOWN, error
+} loadgen_client;
+
+bool sendRequest(char *socket_path, char *payload, size_t payload_size, char **response, size_t *capacity) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *) &address, sizeof(address)) == -1) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t size;
+    bool ok = writeAll(fd, payload, payload_size, -1) && shutdown(fd, SHUT_WR) == 0 && readAll(fd, response, capacity, &size, -1);
+    close(fd);
+    return ok;
+}
+void *loadgenClient(void *arg) {
+    loadgen_client *client = arg;
+    char *response = NULL;
+    size_t capacity = 0;
+    for (int i=0; i<client->num_requests; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool ok = sendRequest(client->socket_path, client->payload, client->payload_size, &response, &capacity);
+        client->latencies[i] = elapsedMs(start);
+        if (!ok) {
+            client->outcomes[3]++;
+        } else if (strncmp(response, "s SATISFIABLE", 13) == 0) {
+            client->outcomes[0]++;
+        } else if (strncmp(response, "s UNSATISFIABLE", 15) == 0) {
+            client->outcomes[1]++;
+        } else if (strncmp(response, "s UNKNOWN", 9) == 0) {
+            client->outcomes[2]++;
+        } else {
+            client->outcomes[3]++;
+        }
+    }
+    free(response);
+    return NULL;
+}
+int runLoadgen(char *socket_path, char *filename, int num_requests, int num_clients) { // benchmarks a running daemon with copies of one instance
+    FILE *input = fopen(filename, "rb");
+    if (input == NULL) {
+        printf("%s not found.\n", filename);
+        return 1;
+    }
+    fseek(input, 0, SEEK_END);
+    size_t payload_size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    char *payload = malloc(payload_size + 1);
+    if (payload == NULL || fread(payload, 1, payload_size, input) != payload_size) {
+        printf("could not read %s.\n", filename);
+        return 1;
+    }
+    fclose(input);
+    if (num_clients < 1) {
+        num_clients = 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // a daemon dying mid-request shows up as a failed request instead
+
+    loadgen_client *clients = calloc(num_clients, sizeof(loadgen_client));
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_clients);
+    double *latencies = malloc(sizeof(double) * num_requests + 1);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int assigned = 0;
+    for (int i=0; i<num_clients; i++) { // spreading the requests as evenly as possible
+        clients[i].socket_path = socket_path;
+        clients[i].payload = payload;
+        clients[i].payload_size = payload_size;
+        clients[i].num_requests = num_requests / num_clients + (i < num_requests % num_clients);
+        clients[i].latencies = latencies + assigned;
+        assigned += clients[i].num_requests;
+        pthread_create(&threads[i], NULL, loadgenClient, &clients[i]);
+    }
+    int outcomes[4] = {0, 0, 0, 0};
+    for (int i=0; i<num_clients; i++) {
+        pthread_join(threads[i], NULL);
+        for (int k=0; k<4; k++) {
+            outcomes[k] += clients[i].outcomes[k];
+        }
+    }
+    double total_ms = elapsedMs(start);
+    printf("%d requests from %d clients in %.3f s (%.1f requests/s)\n", num_requests, num_clients, total_ms / 1000, num_requests / (total_ms / 1000));
+    printf("SAT: %d, UNSAT: %d, timed out: %d, failed: %d\n", outcomes[0], outcomes[1], outcomes[2], outcomes[3]);
+    char stats[256];
+    formatLatencies(stats, sizeof(stats), latencies, num_requests);
+    printf("Client %s", stats);
+    char *response = NULL;
+    size_t capacity = 0;
+    if (sendRequest(socket_path, "STATS", 5, &response, &capacity)) {
+        printf("Daemon %s", response);
+    }
+    free(response);
+    free(payload);
+    free(clients);
+    free(threads);
+    free(latencies);
+    return 0;
+}
+
+int main(int argc, char *argv[]) { // call this program with [--count] [--cache] [--proof] */*.cnf, --check file.cnf file.cnf.drat, --daemon socket, or --loadgen socket file.cnf requests clients
     SAT_problem prob;
     clock_t start, end;
     int file_index = 1;
+    bool count_mode = false;
+    bool use_cache = false;
+    bool write_proof = false;
+    while (file_index < argc && strncmp(argv[file_index], "--", 2) == 0) { // options come before the files
+        if (strcmp(argv[file_index], "--count") == 0) {
+            count_mode = true;
+        } else if (strcmp(argv[file_index], "--cache") == 0) { // keep a binary copy of each instance to skip parsing next time
+            use_cache = true;
+        } else if (strcmp(argv[file_index], "--proof") == 0) { // DRAT proof of each DPLL run in file.cnf.drat
+            write_proof = true;
+        } else if (strcmp(argv[file_index], "--check") == 0 && file_index+2 < argc) {
+            prob = readInFile(argv[file_index+1]);
+            bool verified = checkProof(prob, argv[file_index+2]);
+            freeProblem(prob);
+            return verified ? 0 : 1;
+        } else if (strcmp(argv[file_index], "--daemon") == 0 && file_index+1 < argc) {
+            return runDaemon(argv[file_index+1]);
+        } else if (strcmp(argv[file_index], "--loadgen") == 0 && file_index+4 < argc) {
+            return runLoadgen(argv[file_index+1], argv[file_index+2], atoi(argv[file_index+3]), atoi(argv[file_index+4]));
+        } else {
+            printf("Unknown option %s.\n", argv[file_index]);
+            exit(1);
+        }
+        file_index++;
+    }
     FILE *results; // final experiment stuff
     results = fopen("results.csv", "a");
-    fprintf(results, "file,DPLL output,DPLL time (s),WalkSAT output,WalkSAT time (s),genetic output, genetic time (s)\n");
+    if (count_mode) {
+        fprintf(results, "file,model count,#SAT time (s)\n");
+    } else {
+        fprintf(results, "file,DPLL output,DPLL time (s),WalkSAT output,WalkSAT time (s),genetic output, genetic time (s)\n");
+    }
     while (file_index < argc) {
-        prob = readInFile(argv[file_index]);
+        prob = use_cache ? readInFileCached(argv[file_index]) : readInFile(argv[file_index]);
         printf("%s:\n", argv[file_index]);
         fprintf(results, "%s,", argv[file_index]);
-        for (int i=0; i<3; i++) {
+        if (count_mode) {
+            printf("Begin #SAT:\n");
+            bignum count;
+            start = clock();
+            modelCountSAT(prob, &count);
+            end = clock();
+            char *count_string = bigToString(count);
+            printf("Models: %s\n", count_string);
+            printf("-----------------------------\n\n");
+            fprintf(results, "%s,%f\n", count_string, ((double) (end - start)) / CLOCKS_PER_SEC);
+            free(count_string);
+            bigFree(&count);
+        }
+        for (int i=0; i<3 && !count_mode; i++) {
             switch (i) {
                 case 0: // DPLL
                     printf("Begin DPLL:\n");
                     start = clock();
-                    fprintf(results, "%d,", DPLLSAT(prob));
+                    proof_writer *proof = NULL;
+                    char *proof_filename = malloc(strlen(argv[file_index]) + 6);
+                    sprintf(proof_filename, "%s.drat", argv[file_index]);
+                    if (write_proof && (proof = openProof(proof_filename, prob.num_variables)) == NULL) {
+                        printf("could not write proof %s.\n", proof_filename);
+                    }
+                    bool DPLL_result = DPLLSAT(prob, proof);
+                    if (proof != NULL) {
+                        bool proof_written = closeProof(proof); // counted in the DPLL time since that is what proof logging costs
+                        if (DPLL_result) { // the model is the certificate; the lemmas of the refuted branches are of no use
+                            remove(proof_filename);
+                        } else if (proof_written) {
+                            printf("Proof written to %s\n", proof_filename);
+                        } else { // disk full etc.; a truncated proof is worse than none
+                            printf("could not write proof %s.\n", proof_filename);
+                            remove(proof_filename);
+                        }
+                    }
+                    free(proof_filename);
                     end = clock();
+                    fprintf(results, "%d,", DPLL_result);
                     printf("-----------------------------\n");
                     fprintf(results, "%f,", ((double) (end - start)) / CLOCKS_PER_SEC);
                     break;
@@ -714,10 +2754,7 @@ int main(int argc, char *argv[]) { // call this program with */*.cnf
                     break;
             }
         }
-        for (int i=0; i<prob.num_clauses; i++) {
-            free(prob.clauses[i]);
-        }
-        free(prob.clauses);
+        freeProblem(prob);
         file_index++;
     }
     fclose(results);
@@ -727,7 +2764,7 @@ int main(int argc, char *argv[]) { // call this program with */*.cnf
     //printf("%d\n", WalkSAT(prob, 0.2, 10000));
     //printclauses(prob);
     //prob = readInFile(S_CNF_FILE);
-    /* printf("%d\n", DPLLSAT(prob));
+    /* printf("%d\n", DPLLSAT(prob, NULL));
     printf("%d\n", WalkSAT(prob, 0.2, 10000));
     printf("%d\n", geneticSAT(prob, 300, 10000)); */
     /* for (int i=0; i<prob.num_clauses; i++) {
@@ -747,7 +2784,7 @@ int main(int argc, char *argv[]) { // call this program with */*.cnf
             fprintf(results, "%s,", argv[file_index]);
             printf("Begin DPLL:\n");
             start = clock();
-            fprintf(results, "%d,", DPLLSAT(prob));
+            fprintf(results, "%d,", DPLLSAT(prob, NULL));
             end = clock();
             printf("-----------------------------\n");
             fprintf(results, "%f,", ((double) (end - start)) / CLOCKS_PER_SEC);